@@ -0,0 +1,34 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include "boundaryclassifier.h"
+
+static uint8_t const N = NO_BOUNDARY;
+static uint8_t const A = BOUNDARY_AHEAD;
+static uint8_t const L = BOUNDARY_LEFT;
+static uint8_t const R = BOUNDARY_RIGHT;
+
+// Left, centre, right.
+template <>
+uint8_t const BoundaryTable<3>::directions[1 << 3] PROGMEM =
+{
+    N, L, A, A, R, A, A, A
+};
+
+// Outer left, left, centre, right, outer right. Either sensor on a side
+// counts as that side.
+template <>
+uint8_t const BoundaryTable<5>::directions[1 << 5] PROGMEM =
+{
+    // Right sensors clear.
+    N, L, L, L, A, A, A, A,
+    // Right.
+    R, A, A, A, A, A, A, A,
+    // Outer right.
+    R, A, A, A, A, A, A, A,
+    // Right and outer right.
+    R, A, A, A, A, A, A, A
+};
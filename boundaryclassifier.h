@@ -0,0 +1,172 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+// Smallest spread between a sensor's lowest and highest calibration readings
+// for its calibration to be used. A sensor that has not yet seen both the
+// ring and the border keeps the shared threshold.
+#ifndef LINE_CALIBRATION_MIN_RANGE
+#define LINE_CALIBRATION_MIN_RANGE 500
+#endif
+
+// Boundary directions, from `BoundaryClassifier::classify()`.
+enum Boundary : uint8_t
+{
+    NO_BOUNDARY,
+    BOUNDARY_AHEAD,
+    BOUNDARY_LEFT,
+    BOUNDARY_RIGHT
+};
+
+// Direction for each mask of sensors over the border, for `SENSORS` line
+// sensors. Bit `i` of the mask is sensor `i`, left to right. The centre
+// sensor, or sensors on both sides, mean the border is ahead. In program
+// memory; read entries with pgm_read_byte().
+template <uint8_t SENSORS>
+struct BoundaryTable
+{
+    static uint8_t const directions[1 << SENSORS];
+};
+
+template <>
+uint8_t const BoundaryTable<3>::directions[1 << 3];
+
+template <>
+uint8_t const BoundaryTable<5>::directions[1 << 5];
+
+// Line sensor boundary classifier.
+//
+// Each reading is compared with its own sensor's threshold, the results are
+// packed into a bitmask, and the bitmask is looked up in `BoundaryTable`, so
+// classification costs one compare per sensor and no branches on the
+// pattern.
+//
+// Thresholds come from calibration. `calibrate()` widens each sensor's range
+// of readings; once a sensor's range spans at least
+// LINE_CALIBRATION_MIN_RANGE, its threshold is placed `fraction` / 256 of the
+// way from its lowest (white) to its highest (black) reading, so sensors that
+// read brighter or darker than the others are judged on their own scale.
+// Until then, a sensor uses the shared threshold.
+template <uint8_t SENSORS>
+class BoundaryClassifier
+{
+public:
+    struct Calibration
+    {
+        uint16_t minimum[SENSORS];
+        uint16_t maximum[SENSORS];
+    };
+
+    BoundaryClassifier() :
+        m_shared_threshold(0),
+        m_fraction(0)
+    {
+        reset_calibration();
+    }
+
+    // Shared threshold for uncalibrated sensors, and position of calibrated
+    // thresholds in 1/256ths of each sensor's range.
+    void configure(uint16_t threshold, uint8_t fraction)
+    {
+        m_shared_threshold = threshold;
+        m_fraction = fraction;
+        update_thresholds();
+    }
+
+    void reset_calibration()
+    {
+        for (uint8_t i = 0; i < SENSORS; ++i)
+        {
+            m_calibration.minimum[i] = 0xFFFF;
+            m_calibration.maximum[i] = 0;
+        }
+        update_thresholds();
+    }
+
+    // Widen each sensor's calibrated range to include `values`.
+    void calibrate(unsigned int const * values)
+    {
+        for (uint8_t i = 0; i < SENSORS; ++i)
+        {
+            if (values[i] < m_calibration.minimum[i])
+            {
+                m_calibration.minimum[i] = values[i];
+            }
+            if (values[i] > m_calibration.maximum[i])
+            {
+                m_calibration.maximum[i] = values[i];
+            }
+        }
+        update_thresholds();
+    }
+
+    void set_calibration(Calibration const & calibration)
+    {
+        m_calibration = calibration;
+        update_thresholds();
+    }
+
+    Calibration const & calibration() const
+    {
+        return m_calibration;
+    }
+
+    uint16_t threshold(uint8_t sensor) const
+    {
+        return m_thresholds[sensor];
+    }
+
+    // Sensors reading below their threshold (over the border).
+    uint8_t mask(unsigned int const * values) const
+    {
+        uint8_t mask = 0;
+        for (uint8_t i = 0; i < SENSORS; ++i)
+        {
+            mask |= (values[i] < m_thresholds[i]) << i;
+        }
+        return mask;
+    }
+
+    static Boundary direction(uint8_t mask)
+    {
+        return static_cast<Boundary>(
+            pgm_read_byte(&BoundaryTable<SENSORS>::directions[mask])
+        );
+    }
+
+    Boundary classify(unsigned int const * values) const
+    {
+        return direction(mask(values));
+    }
+
+private:
+    void update_thresholds()
+    {
+        for (uint8_t i = 0; i < SENSORS; ++i)
+        {
+            uint16_t const low = m_calibration.minimum[i];
+            uint16_t const high = m_calibration.maximum[i];
+            if (high > low && high - low >= LINE_CALIBRATION_MIN_RANGE)
+            {
+                m_thresholds[i] = low +
+                    static_cast<uint32_t>(high - low) * m_fraction / 256;
+            }
+            else
+            {
+                m_thresholds[i] = m_shared_threshold;
+            }
+        }
+    }
+
+    uint16_t m_shared_threshold;
+    uint8_t m_fraction;
+    Calibration m_calibration;
+    uint16_t m_thresholds[SENSORS];
+};
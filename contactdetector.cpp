@@ -0,0 +1,136 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include "contactdetector.h"
+
+// Accelerometer counts per g at +/-8 g full scale.
+static int32_t const COUNTS_PER_G = 4096;
+
+static int32_t magnitude(int32_t x, int32_t y)
+{
+    return (x < 0 ? -x : x) + (y < 0 ? -y : y);
+}
+
+ContactDetector::ContactDetector() :
+    m_collision_threshold(0),
+    m_push_threshold(0)
+{
+    reset();
+}
+
+void ContactDetector::reset()
+{
+    for (uint8_t i = 0; i < 2; ++i)
+    {
+        m_bias[i] = 0;
+        m_smooth[i] = 0;
+        m_push[i] = 0;
+    }
+    m_push_samples = 0;
+    m_pushing = false;
+    m_holdoff = 0;
+    m_type = COLLISION;
+    m_side = CONTACT_FRONT;
+    m_strength = 0;
+}
+
+void ContactDetector::configure(uint16_t collision_mg, uint16_t push_mg)
+{
+    m_collision_threshold = static_cast<int32_t>(collision_mg) *
+        COUNTS_PER_G / 1000;
+    m_push_threshold = static_cast<int32_t>(push_mg) * COUNTS_PER_G / 1000;
+}
+
+bool ContactDetector::update(int16_t x, int16_t y, bool settled)
+{
+    int16_t const sample[2] = {x, y};
+    int32_t high[2];
+    int32_t push[2];
+
+    for (uint8_t i = 0; i < 2; ++i)
+    {
+        // Bias, then the sample without it, in 28.4.
+        if (!m_pushing)
+        {
+            m_bias[i] += ((static_cast<int32_t>(sample[i]) << 8) - m_bias[i])
+                >> CONTACT_BIAS_SHIFT;
+        }
+        int32_t const value =
+            (static_cast<int32_t>(sample[i]) << 4) - (m_bias[i] >> 4);
+
+        m_smooth[i] += (value - m_smooth[i]) >> CONTACT_HIGH_PASS_SHIFT;
+        high[i] = (value - m_smooth[i]) >> 4;
+        m_push[i] += (value - m_push[i]) >> CONTACT_PUSH_SHIFT;
+        push[i] = m_push[i] >> 4;
+    }
+
+    bool found = false;
+
+    if (m_holdoff)
+    {
+        --m_holdoff;
+    }
+    else if (magnitude(high[0], high[1]) >= m_collision_threshold)
+    {
+        m_holdoff = CONTACT_HOLDOFF_SAMPLES;
+        detected(COLLISION, high[0], high[1]);
+        found = true;
+    }
+
+    int32_t const push_magnitude = magnitude(push[0], push[1]);
+    if (m_pushing)
+    {
+        m_pushing = push_magnitude >= m_push_threshold / 2;
+    }
+    else if (settled && push_magnitude >= m_push_threshold)
+    {
+        // A collision on this sample holds the push over to the next.
+        if (++m_push_samples >= CONTACT_PUSH_SAMPLES && !found)
+        {
+            m_push_samples = 0;
+            m_pushing = true;
+            detected(PUSHED, push[0], push[1]);
+            found = true;
+        }
+    }
+    else
+    {
+        m_push_samples = 0;
+    }
+
+    return found;
+}
+
+ContactType ContactDetector::type() const
+{
+    return m_type;
+}
+
+ContactSide ContactDetector::side() const
+{
+    return m_side;
+}
+
+uint8_t ContactDetector::strength() const
+{
+    return m_strength;
+}
+
+void ContactDetector::detected(ContactType type, int32_t x, int32_t y)
+{
+    int32_t const strength = magnitude(x, y) / (COUNTS_PER_G / 16);
+
+    m_type = type;
+    if ((x < 0 ? -x : x) >= (y < 0 ? -y : y))
+    {
+        m_side = x < 0 ? CONTACT_FRONT : CONTACT_REAR;
+    }
+    else
+    {
+        m_side = y < 0 ? CONTACT_LEFT : CONTACT_RIGHT;
+    }
+    m_strength = strength < 255 ? strength : 255;
+}
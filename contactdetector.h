@@ -0,0 +1,101 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "events.h"
+
+// Filter constants, as shifts: each sample moves a filter 1 / 2^shift of the
+// way to it. At 400 samples per second (see ACCELEROMETER_RATE), the bias
+// follows over about 2.5 s, the collision high-pass passes changes faster than
+// about 10 ms, and the push low-pass smooths over about 40 ms.
+#ifndef CONTACT_BIAS_SHIFT
+#define CONTACT_BIAS_SHIFT 10
+#endif
+
+#ifndef CONTACT_HIGH_PASS_SHIFT
+#define CONTACT_HIGH_PASS_SHIFT 2
+#endif
+
+#ifndef CONTACT_PUSH_SHIFT
+#define CONTACT_PUSH_SHIFT 4
+#endif
+
+// Samples a push must last to be reported (100 ms at 400 per second), and
+// samples after a collision (200 ms) before another is reported.
+#ifndef CONTACT_PUSH_SAMPLES
+#define CONTACT_PUSH_SAMPLES 40
+#endif
+
+#ifndef CONTACT_HOLDOFF_SAMPLES
+#define CONTACT_HOLDOFF_SAMPLES 80
+#endif
+
+// Time after the robot's motor command last changed before `IRobot` counts
+// its motion as settled, for push detection.
+#ifndef CONTACT_SETTLE_MS
+#define CONTACT_SETTLE_MS 250
+#endif
+
+// Accelerometer collision and push detection.
+//
+// Takes the horizontal axes of the accelerometer (x forward, y left), in raw
+// counts at +/-8 g full scale, one sample at a time, all in fixed point. A
+// slowly tracking bias takes out the sensor offset and any tilt. Then:
+//   - a collision is a sample whose high-passed acceleration reaches the
+//     collision threshold. Further collisions are ignored for
+//     CONTACT_HOLDOFF_SAMPLES, so one impact is one report.
+//   - a push is low-passed acceleration at or above the push threshold for
+//     CONTACT_PUSH_SAMPLES in a row, while the robot's own motor command has
+//     settled (so the acceleration is not its own). It is reported once,
+//     and again only after the acceleration falls below half the threshold.
+// Magnitudes are the sum of the two axes' magnitudes, which saves a square
+// root at the cost of reading diagonal accelerations up to 41% high.
+//
+// The contact's side is opposite to the acceleration it causes: a hit on
+// the front throws the robot backwards.
+class ContactDetector
+{
+public:
+    ContactDetector();
+
+    void reset();
+
+    // Thresholds, in thousandths of g.
+    void configure(uint16_t collision_mg, uint16_t push_mg);
+
+    // Update from one sample. `settled` is whether the robot's own motion
+    // has settled, so pushes can be told apart from it. Returns `true` if a
+    // contact was detected; see `type()`, `side()` and `strength()`.
+    bool update(int16_t x, int16_t y, bool settled);
+
+    ContactType type() const;
+    ContactSide side() const;
+
+    // Acceleration at the last detection, in 1/16 g, saturating at 255.
+    uint8_t strength() const;
+
+private:
+    void detected(ContactType type, int32_t x, int32_t y);
+
+    int32_t m_collision_threshold;
+    int32_t m_push_threshold;
+
+    // Filter states: bias in 24.8, high-pass and push low-pass in 28.4
+    // fixed point.
+    int32_t m_bias[2];
+    int32_t m_smooth[2];
+    int32_t m_push[2];
+
+    uint8_t m_push_samples;
+    bool m_pushing;
+    uint8_t m_holdoff;
+
+    ContactType m_type;
+    ContactSide m_side;
+    uint8_t m_strength;
+};
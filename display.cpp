@@ -0,0 +1,98 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include "display.h"
+
+void Display::setup()
+{
+    m_lcd.clear();
+    memset(m_screen, ' ', CELLS);
+    memset(m_frame, ' ', CELLS);
+    m_cursor = 0;
+    m_next = 0;
+    m_max_write_us = 0;
+}
+
+void Display::clear()
+{
+    memset(m_frame, ' ', CELLS);
+}
+
+void Display::print(uint8_t line, char const * msg)
+{
+    if (line >= HEIGHT)
+    {
+        return;
+    }
+
+    char * row = &m_frame[line * WIDTH];
+    uint8_t x = 0;
+    for (; x < WIDTH && msg[x]; ++x)
+    {
+        row[x] = msg[x];
+    }
+    for (; x < WIDTH; ++x)
+    {
+        row[x] = ' ';
+    }
+}
+
+bool Display::update(uint16_t budget_us)
+{
+    unsigned long const start = micros();
+    bool wrote = false;
+
+    for (uint8_t checked = 0; checked < CELLS; ++checked)
+    {
+        uint8_t const cell = m_next;
+        if (m_frame[cell] != m_screen[cell])
+        {
+            // The first write always goes ahead, so the screen keeps
+            // updating whatever the estimate.
+            if (wrote && micros() - start + m_max_write_us > budget_us)
+            {
+                // Out of time. Resume from this cell next time.
+                return false;
+            }
+
+            unsigned long const write_start = micros();
+            if (cell != m_cursor)
+            {
+                m_lcd.gotoXY(cell % WIDTH, cell / WIDTH);
+            }
+            m_lcd.write(static_cast<uint8_t>(m_frame[cell]));
+            m_screen[cell] = m_frame[cell];
+            // The cursor does not wrap to the next line.
+            m_cursor = (cell + 1) % WIDTH ? cell + 1 : CELLS;
+
+            wrote = true;
+
+            // Track the longest recent write. Decay towards shorter ones, so
+            // one write stretched by an interrupt does not cut every later
+            // update short, and never expect more than the budget.
+            unsigned long const write_us = micros() - write_start;
+            if (write_us > m_max_write_us)
+            {
+                m_max_write_us = write_us;
+            }
+            else
+            {
+                m_max_write_us -= (m_max_write_us - write_us) >> 3;
+            }
+            if (m_max_write_us > budget_us)
+            {
+                m_max_write_us = budget_us;
+            }
+        }
+
+        if (++m_next >= CELLS)
+        {
+            m_next = 0;
+        }
+    }
+
+    return true;
+}
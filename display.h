@@ -0,0 +1,61 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <Zumo32U4.h>
+
+// Framebuffer for the Zumo32U4's 8x2 character LCD.
+//
+// `clear()` and `print()` only change the framebuffer. `update()` copies the
+// characters that differ from what is on screen to the LCD, a few at a time,
+// within a time budget, so nothing that changes the display blocks the
+// control loop on LCD writes.
+class Display
+{
+public:
+    static uint8_t const WIDTH = 8;
+    static uint8_t const HEIGHT = 2;
+
+    // Call in `IRobot::setup()`. Clears the LCD, which blocks.
+    void setup();
+
+    // Blank the framebuffer.
+    void clear();
+
+    // Write `msg` to the start of framebuffer line `line`, and blank the
+    // rest of the line. Characters past the end of the line are dropped.
+    void print(uint8_t line, char const * msg);
+
+    // Write changed characters to the LCD until the screen matches the
+    // framebuffer, or until another write could take the time spent past
+    // `budget_us`. At least one changed character is written per call, so
+    // the screen keeps updating even when a write takes longer than the
+    // budget (about 50 us each).
+    //
+    // Returns `true` if the screen matches the framebuffer.
+    bool update(uint16_t budget_us);
+
+private:
+    static uint8_t const CELLS = WIDTH * HEIGHT;
+
+    Zumo32U4LCD m_lcd;
+
+    // Wanted and actual screen contents, row major.
+    char m_frame[CELLS];
+    char m_screen[CELLS];
+
+    // Cell the LCD cursor is on, or CELLS if it is off screen.
+    uint8_t m_cursor;
+
+    // Next cell for `update()` to check, so a run cut short by the budget
+    // resumes where it stopped.
+    uint8_t m_next;
+
+    // Longest recent LCD operation, for budgeting. Decays towards shorter
+    // writes, and is capped at the budget.
+    uint16_t m_max_write_us;
+};
@@ -0,0 +1,134 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Wheels an encoder target measures.
+enum Wheel : uint8_t
+{
+    LEFT_WHEEL = 1,
+    RIGHT_WHEEL = 2,
+    // Mean distance of both wheels.
+    BOTH_WHEELS = LEFT_WHEEL | RIGHT_WHEEL
+};
+
+// Encoder distance targets.
+//
+// Holds `TARGETS` targets, identified by index, any number of which may be
+// active at once. Each measures the distance turned by one or both wheels
+// since it was started, from running 32-bit encoder totals, so targets do not
+// disturb each other by resetting the encoders.
+//
+// Targets are checked whenever new totals are available. A target completes
+// at the check closest to when it is reached: if the distance covered since
+// the previous check says the target will be passed by more than half a step
+// before the next check, it completes now. This halves the typical overshoot
+// of completing only once the target has been passed.
+template <uint8_t TARGETS>
+class EncoderTargets
+{
+public:
+    EncoderTargets()
+    {
+        for (Target & target : m_targets)
+        {
+            target.wheels = 0;
+        }
+    }
+
+    // Start, or restart, target `id` to complete once `wheels` have turned
+    // `distance` counts, in either direction, from totals `left`, `right`.
+    void start(
+        uint8_t id,
+        uint8_t wheels,
+        uint16_t distance,
+        int32_t left,
+        int32_t right
+    )
+    {
+        Target & target = m_targets[id];
+        target.left_start = left;
+        target.right_start = right;
+        target.distance = distance;
+        target.progress = 0;
+        target.wheels = wheels;
+    }
+
+    void cancel(uint8_t id)
+    {
+        m_targets[id].wheels = 0;
+    }
+
+    bool active(uint8_t id) const
+    {
+        return m_targets[id].wheels != 0;
+    }
+
+    // Check active targets against encoder totals `left`, `right`, and call
+    // `on_complete(id)` for each target that completes. Completed targets
+    // are no longer active.
+    template <typename F>
+    void check(int32_t left, int32_t right, F on_complete)
+    {
+        for (uint8_t id = 0; id < TARGETS; ++id)
+        {
+            Target & target = m_targets[id];
+            if (!target.wheels)
+            {
+                continue;
+            }
+
+            uint32_t const left_distance = distance(left - target.left_start);
+            uint32_t const right_distance =
+                distance(right - target.right_start);
+            uint32_t progress;
+            switch (target.wheels)
+            {
+            case LEFT_WHEEL:
+                progress = left_distance;
+                break;
+            case RIGHT_WHEEL:
+                progress = right_distance;
+                break;
+            default:
+                progress = (left_distance + right_distance) / 2;
+                break;
+            }
+
+            // Progress goes down when a wheel reverses. That is no step
+            // towards the target, so it must not predict completion.
+            int32_t const change =
+                static_cast<int32_t>(progress - target.progress);
+            uint32_t const step = change > 0 ? change : 0;
+            target.progress = progress;
+            if (progress + step / 2 >= target.distance)
+            {
+                target.wheels = 0;
+                on_complete(id);
+            }
+        }
+    }
+
+private:
+    static uint32_t distance(int32_t counts)
+    {
+        return counts < 0 ? -counts : counts;
+    }
+
+    struct Target
+    {
+        int32_t left_start;
+        int32_t right_start;
+        uint32_t progress;
+        uint16_t distance;
+        // Wheel mask, or 0 if inactive.
+        uint8_t wheels;
+    };
+
+    Target m_targets[TARGETS];
+};
@@ -0,0 +1,64 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include "eventfilter.h"
+
+EventFilter::EventFilter() :
+    m_policy(LEVEL),
+    m_report_idle(true),
+    m_last_value(0),
+    m_period_ms(0),
+    m_last_report_ms(0),
+    m_suppressed(0)
+{}
+
+void EventFilter::set_policy(
+    EventPolicy policy,
+    uint16_t period_ms,
+    bool report_idle
+)
+{
+    m_policy = policy;
+    m_period_ms = period_ms;
+    m_report_idle = report_idle;
+}
+
+bool EventFilter::accept(uint8_t value, unsigned long now_ms)
+{
+    bool const changed = value != m_last_value;
+    m_last_value = value;
+
+    if (!value && !m_report_idle)
+    {
+        // Idle samples are never events for this source.
+        return false;
+    }
+
+    bool report = true;
+    switch (m_policy)
+    {
+    case EDGE:
+        report = changed;
+        break;
+    case RATE_LIMITED:
+        // Unsigned subtraction keeps working across millis() wraparound.
+        report = changed || now_ms - m_last_report_ms >= m_period_ms;
+        break;
+    default:
+        break;
+    }
+
+    if (report)
+    {
+        m_last_report_ms = now_ms;
+    }
+    else
+    {
+        ++m_suppressed;
+    }
+
+    return report;
+}
@@ -0,0 +1,52 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <stdint.h>
+
+// How often a sensor source turns its samples into events.
+enum EventPolicy : uint8_t
+{
+    // Every sample.
+    LEVEL,
+    // Only samples that differ from the previous sample.
+    EDGE,
+    // Samples that differ from the previous sample, plus repeats of an
+    // unchanged sample once the rate limiting period has passed.
+    RATE_LIMITED
+};
+
+// Per-source event filter. Samples are small values (e.g. a
+// `DetectDirection`), where zero means idle (nothing detected).
+class EventFilter
+{
+public:
+    EventFilter();
+
+    // Set the policy.
+    //
+    // `period_ms` is the rate limiting period, used by RATE_LIMITED.
+    //
+    // `report_idle` => idle samples are events too. Otherwise, idle samples
+    // are never reported, but still count as a change for EDGE.
+    void set_policy(EventPolicy policy, uint16_t period_ms, bool report_idle);
+
+    // Filter a sample. Returns `true` if it should become an event.
+    bool accept(uint8_t value, unsigned long now_ms);
+
+    // Number of samples the LEVEL policy would have reported, but this one
+    // did not.
+    unsigned long suppressed() const { return m_suppressed; }
+
+private:
+    EventPolicy m_policy;
+    bool m_report_idle;
+    uint8_t m_last_value;
+    uint16_t m_period_ms;
+    unsigned long m_last_report_ms;
+    unsigned long m_suppressed;
+};
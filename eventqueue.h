@@ -6,23 +6,274 @@
  */
 #pragma once
 
+#include <stdint.h>
 #include "events.h"
 
-// QUEUE_SIZE should equal, at most, the number of event types, since each event
-// is statically allocated in the .ino file, and in a worst case, at most all
-// events get triggered.
-#define QUEUE_SIZE 6
+// Number of event queue slots per lane. Must be a power of two, and at most
+// 128. Pushes onto a full lane are dropped and counted, so size the lanes for
+// the worst case burst between drains, as shown by `high_water_mark()`.
+#define QUEUE_SIZE 4
 
-class EventQueue
+// Single-producer, single-consumer ring buffer.
+//
+// One context (e.g. `loop()`, or one interrupt handler) may push while
+// another pops, without disabling interrupts. Each index is a single byte
+// written by only one side, so reads and writes of it are atomic. If more
+// than one context pushes, the pushes must be serialized (e.g. main-line
+// pushes wrapped in `ATOMIC_BLOCK`).
+//
+// Indices run freely from 0 to 255 and are masked into the buffer, so a
+// full queue uses every slot.
+template <typename T, uint8_t CAPACITY>
+class SpscQueue
+{
+    static_assert(
+        CAPACITY && !(CAPACITY & (CAPACITY - 1)),
+        "Queue capacity must be a power of two."
+    );
+    static_assert(CAPACITY <= 128, "Queue capacity must be at most 128.");
+
+public:
+    SpscQueue() :
+        m_write_idx(0),
+        m_read_idx(0),
+        m_high_water_mark(0),
+        m_dropped(0),
+        m_coalesced(0)
+    {}
+
+    // Consumer and producer.
+    bool empty() const
+    {
+        return load(m_write_idx) == load(m_read_idx);
+    }
+
+    uint8_t size() const
+    {
+        return static_cast<uint8_t>(load(m_write_idx) - load(m_read_idx));
+    }
+
+    // Producer. Returns false, and counts the drop, if the queue is full.
+    bool push(T const & value)
+    {
+        uint8_t const write_idx = m_write_idx;
+        uint8_t const used = static_cast<uint8_t>(write_idx - load(m_read_idx));
+        if (used >= CAPACITY)
+        {
+            // Saturates rather than wrapping back to no drops.
+            if (m_dropped != 0xFF)
+            {
+                ++m_dropped;
+            }
+            return false;
+        }
+
+        m_buffer[write_idx & MASK] = value;
+        store(m_write_idx, static_cast<uint8_t>(write_idx + 1));
+
+        if (used + 1 > m_high_water_mark)
+        {
+            m_high_water_mark = used + 1;
+        }
+        return true;
+    }
+
+    // Producer. If an entry of the same kind as `value` (compared by
+    // `T::kind()`) is still pending, overwrite the newest such entry with
+    // `value` instead of adding another. Otherwise, push `value`.
+    //
+    // Pending entries are rewritten in place, so only push this way from the
+    // consumer's context (e.g. `loop()`, before draining), never from an
+    // interrupt handler.
+    bool push_or_replace(T const & value)
+    {
+        uint8_t const read_idx = load(m_read_idx);
+        for (uint8_t idx = m_write_idx; idx != read_idx; )
+        {
+            --idx;
+            if (m_buffer[idx & MASK].kind() == value.kind())
+            {
+                m_buffer[idx & MASK] = value;
+                ++m_coalesced;
+                return true;
+            }
+        }
+
+        return push(value);
+    }
+
+    // Consumer. Oldest entry, or `nullptr` if the queue is empty. The entry
+    // stays valid, in place, until `pop()`.
+    T * front()
+    {
+        uint8_t const read_idx = m_read_idx;
+        if (read_idx == load(m_write_idx))
+        {
+            return nullptr;
+        }
+
+        return &m_buffer[read_idx & MASK];
+    }
+
+    // Consumer. Discards the entry returned by `front()`.
+    void pop()
+    {
+        store(m_read_idx, static_cast<uint8_t>(m_read_idx + 1));
+    }
+
+    // Consumer. Returns false if the queue is empty.
+    bool pop(T & value)
+    {
+        uint8_t const read_idx = m_read_idx;
+        if (read_idx == load(m_write_idx))
+        {
+            return false;
+        }
+
+        value = m_buffer[read_idx & MASK];
+        store(m_read_idx, static_cast<uint8_t>(read_idx + 1));
+        return true;
+    }
+
+    // Most slots ever in use at once.
+    uint8_t high_water_mark() const { return m_high_water_mark; }
+
+    // Number of pushes rejected because the queue was full, up to 255. A
+    // single byte, like the indices, so the consumer reads it whole while
+    // the producer counts.
+    uint8_t dropped() const { return m_dropped; }
+
+    // Number of entries overwritten by `push_or_replace()`.
+    unsigned long coalesced() const { return m_coalesced; }
+
+private:
+    static uint8_t const MASK = CAPACITY - 1;
+
+#ifdef __AVR__
+    // Byte accesses are atomic on AVR. The barrier keeps buffer accesses from
+    // being reordered across the index update.
+    static uint8_t load(uint8_t const volatile & idx)
+    {
+        uint8_t const value = idx;
+        __asm__ __volatile__ ("" ::: "memory");
+        return value;
+    }
+
+    static void store(uint8_t volatile & idx, uint8_t value)
+    {
+        __asm__ __volatile__ ("" ::: "memory");
+        idx = value;
+    }
+#else
+    static uint8_t load(uint8_t const volatile & idx)
+    {
+        return __atomic_load_n(&idx, __ATOMIC_ACQUIRE);
+    }
+
+    static void store(uint8_t volatile & idx, uint8_t value)
+    {
+        __atomic_store_n(&idx, value, __ATOMIC_RELEASE);
+    }
+#endif
+
+    T m_buffer[CAPACITY];
+    uint8_t volatile m_write_idx;
+    uint8_t volatile m_read_idx;
+    uint8_t m_high_water_mark;
+    uint8_t m_dropped;
+    unsigned long m_coalesced;
+};
+
+// Multi-lane queue of `LANES` single-producer, single-consumer lanes. Entries
+// are queued in lane `T::lane()`, and `front()` always returns the oldest
+// entry of the highest priority (lowest numbered) non-empty lane, so an urgent
+// entry pushed mid-drain is dispatched next.
+//
+// Producer and consumer rules are the same as for `SpscQueue`, per lane.
+template <typename T, uint8_t LANE_CAPACITY, uint8_t LANES>
+class PriorityQueue
 {
 public:
-    EventQueue();
-    bool empty();
-    void push(Event * e);
-    Event * pop();
+    PriorityQueue() : m_front_lane(0) {}
+
+    // Consumer and producer.
+    bool empty() const
+    {
+        for (uint8_t i = 0; i < LANES; ++i)
+        {
+            if (!m_lanes[i].empty())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Producer. Returns false, and counts the drop, if the lane is full.
+    bool push(T const & value)
+    {
+        return m_lanes[value.lane()].push(value);
+    }
+
+    // Producer. See `SpscQueue::push_or_replace()`.
+    bool push_or_replace(T const & value)
+    {
+        return m_lanes[value.lane()].push_or_replace(value);
+    }
+
+    // Consumer. Oldest entry of the highest priority non-empty lane, or
+    // `nullptr` if all lanes are empty. The entry stays valid, in place, until
+    // `pop()`.
+    T * front()
+    {
+        for (uint8_t i = 0; i < LANES; ++i)
+        {
+            T * value = m_lanes[i].front();
+            if (value)
+            {
+                m_front_lane = i;
+                return value;
+            }
+        }
+        return nullptr;
+    }
+
+    // Consumer. Discards the entry returned by `front()`, even if a higher
+    // priority entry has been pushed since.
+    void pop()
+    {
+        m_lanes[m_front_lane].pop();
+    }
+
+    SpscQueue<T, LANE_CAPACITY> const & lane(uint8_t i) const
+    {
+        return m_lanes[i];
+    }
+
+    // Totals over all lanes.
+    uint16_t dropped() const
+    {
+        uint16_t total = 0;
+        for (uint8_t i = 0; i < LANES; ++i)
+        {
+            total += m_lanes[i].dropped();
+        }
+        return total;
+    }
+
+    unsigned long coalesced() const
+    {
+        unsigned long total = 0;
+        for (uint8_t i = 0; i < LANES; ++i)
+        {
+            total += m_lanes[i].coalesced();
+        }
+        return total;
+    }
 
 private:
-    unsigned int m_write_idx;
-    unsigned int m_read_idx;
-    Event * m_queue[6];
-};
\ No newline at end of file
+    SpscQueue<T, LANE_CAPACITY> m_lanes[LANES];
+    uint8_t m_front_lane;
+};
+
+typedef PriorityQueue<RobotEventSlot, QUEUE_SIZE, LANE_COUNT> EventQueue;
@@ -6,23 +6,39 @@
  */
 #pragma once
 
+#include <string.h>
 #include <Zumo32U4.h>
 #include "statemachine.h"
 
 using namespace statemachine;
 
-// There must be one event enumerated value for each event class.
+// There must be one event enumerated value for each event class, and each
+// event class must name its value as `ID`. At most 16 events, so each has a
+// bit in a state's handled events mask.
 enum RobotEvent
 {
     BOUNDARY_EVENT,
+    CONTACT_EVENT,
     ENCODER_EVENT,
     PROXIMITY_EVENT,
     START_EVENT,
     TIMER_EVENT
 };
 
+// Event queue lanes, highest priority first. Events in a higher priority lane
+// are always dispatched before events in a lower priority lane.
+enum EventLane : uint8_t
+{
+    // Must be handled before anything else (e.g. ring boundary).
+    CRITICAL_LANE,
+    NORMAL_LANE,
+    // Superseded by later readings anyway (e.g. proximity).
+    LOW_LANE,
+    LANE_COUNT
+};
+
 // Direction of detection. Used by boundary and proximity sensors.
-enum DetectDirection
+enum DetectDirection : uint8_t
 {
     NONE,
     LEFT,
@@ -34,44 +50,238 @@ enum DetectDirection
 class StartButtonEvent : public Event
 {
 public:
-    StartButtonEvent() : Event(START_EVENT, "start") {}
+    static RobotEvent const ID = START_EVENT;
+
+    StartButtonEvent() : Event(ID, STATEMACHINE_NAME("start")) {}
+};
+
+// Timer identifiers. Each timer runs independently, and its expiration is a
+// `TimerEvent` naming it. Add timers before TIMER_COUNT.
+enum RobotTimer : uint8_t
+{
+    // Timer started by `IRobot::start_timer()` when no timer is named.
+    DEFAULT_TIMER,
+    TIMER_COUNT
 };
 
 // Timer expiration.
 class TimerEvent : public Event
 {
 public:
-    TimerEvent() : Event(TIMER_EVENT, "timer") {}
+    static RobotEvent const ID = TIMER_EVENT;
+
+    TimerEvent(uint8_t timer = DEFAULT_TIMER) :
+        Event(ID, STATEMACHINE_NAME("timer")), m_timer(timer)
+    {}
+
+    // Timer that expired. One of `RobotTimer`.
+    uint8_t m_timer;
 };
 
 // Ring boundary detected.
 class BoundaryEvent : public Event
 {
 public:
-    BoundaryEvent() : Event(BOUNDARY_EVENT, "bdy"), m_direction(NONE) {}
+    static RobotEvent const ID = BOUNDARY_EVENT;
+
+    BoundaryEvent(DetectDirection direction = NONE) :
+        Event(ID, STATEMACHINE_NAME("bdy")), m_direction(direction)
+    {}
 
     DetectDirection m_direction;
 };
 
+// What the accelerometer felt. A collision is a sharp jolt; a push is a
+// steady acceleration the robot's own motors did not cause.
+enum ContactType : uint8_t
+{
+    COLLISION,
+    PUSHED
+};
+
+// Side of the robot a contact came from.
+enum ContactSide : uint8_t
+{
+    CONTACT_FRONT,
+    CONTACT_LEFT,
+    CONTACT_RIGHT,
+    CONTACT_REAR
+};
+
+// Collision or push detected by the accelerometer (see `ContactDetector`).
+class ContactEvent : public Event
+{
+public:
+    static RobotEvent const ID = CONTACT_EVENT;
+
+    ContactEvent(
+        ContactType type = COLLISION,
+        ContactSide side = CONTACT_FRONT,
+        uint8_t strength = 0
+    ) :
+        Event(ID, STATEMACHINE_NAME("contact")),
+        m_type(type),
+        m_side(side),
+        m_strength(strength)
+    {}
+
+    ContactType m_type;
+    ContactSide m_side;
+    // Acceleration at detection, in 1/16 g, saturating at 255.
+    uint8_t m_strength;
+};
+
+// Encoder target identifiers. Each target runs independently, and its
+// completion is an `EncoderEvent` naming it. Add targets before
+// ENCODER_TARGET_COUNT.
+enum RobotEncoderTarget : uint8_t
+{
+    // Target used by `IRobot::spin_left()` and `IRobot::spin_right()`.
+    SPIN_TARGET,
+    ENCODER_TARGET_COUNT
+};
+
 // Wheel encoder has spun desired amount.
 class EncoderEvent : public Event
 {
 public:
-    EncoderEvent() : Event(ENCODER_EVENT, "enc") {}
+    static RobotEvent const ID = ENCODER_EVENT;
+
+    EncoderEvent(uint8_t target = SPIN_TARGET) :
+        Event(ID, STATEMACHINE_NAME("enc")), m_target(target)
+    {}
+
+    // Target that completed. One of `RobotEncoderTarget`.
+    uint8_t m_target;
 };
 
 // Proximity sensor detection.
 class ProximityEvent : public Event
 {
 public:
-    ProximityEvent() : 
-        Event(PROXIMITY_EVENT, "prox"), 
-        m_direction(NONE), 
-        m_left_brightness(0), 
-        m_right_brightness(0) 
+    static RobotEvent const ID = PROXIMITY_EVENT;
+
+    ProximityEvent(
+        DetectDirection direction = NONE,
+        uint8_t left_brightness = 0,
+        uint8_t right_brightness = 0,
+        int8_t bearing = 0,
+        uint8_t confidence = 0
+    ) :
+        Event(ID, STATEMACHINE_NAME("prox")),
+        m_direction(direction),
+        m_left_brightness(left_brightness),
+        m_right_brightness(right_brightness),
+        m_bearing(bearing),
+        m_confidence(confidence)
     {}
     
     DetectDirection m_direction;
+    // Front sensor readings with the left and right LEDs.
     uint8_t m_left_brightness;
     uint8_t m_right_brightness;
+    // Filtered bearing to the opponent in degrees, positive to the left, and
+    // confidence, 0 through 255 (see `ProximityTracker`). Steer on these
+    // for a smooth approach.
+    int8_t m_bearing;
+    uint8_t m_confidence;
+};
+
+// Storage for any one robot event, so events can be queued by value. Each
+// queued event is its own copy, so a later detection of the same type cannot
+// change the payload of one still waiting in the queue.
+//
+// Add a member and constructor here for each new event class, and assign it a
+// lane in `lane()`.
+class RobotEventSlot
+{
+public:
+    RobotEventSlot() :
+        m_kind(NO_EVENT), m_event(NO_EVENT, STATEMACHINE_NAME("none"))
+    {}
+
+    RobotEventSlot(BoundaryEvent const & e) :
+        m_kind(BOUNDARY_EVENT), m_boundary(e)
+    {}
+    RobotEventSlot(ContactEvent const & e) :
+        m_kind(CONTACT_EVENT), m_contact(e)
+    {}
+    RobotEventSlot(EncoderEvent const & e) :
+        m_kind(ENCODER_EVENT), m_encoder(e)
+    {}
+    RobotEventSlot(ProximityEvent const & e) :
+        m_kind(PROXIMITY_EVENT), m_proximity(e)
+    {}
+    RobotEventSlot(StartButtonEvent const & e) :
+        m_kind(START_EVENT), m_start(e)
+    {}
+    RobotEventSlot(TimerEvent const & e) :
+        m_kind(TIMER_EVENT), m_timer(e)
+    {}
+
+    // Events hold no pointers to themselves, so slots copy bytewise.
+    RobotEventSlot(RobotEventSlot const & other)
+    {
+        memcpy(static_cast<void *>(this), &other, sizeof(*this));
+    }
+
+    RobotEventSlot & operator=(RobotEventSlot const & other)
+    {
+        memcpy(static_cast<void *>(this), &other, sizeof(*this));
+        return *this;
+    }
+
+    // Kind of event held. One of the `RobotEvent` values.
+    uint8_t kind() const { return m_kind; }
+
+    // Queue lane for the kind of event held.
+    uint8_t lane() const
+    {
+        switch (m_kind)
+        {
+        case BOUNDARY_EVENT:
+            return CRITICAL_LANE;
+        case PROXIMITY_EVENT:
+            return LOW_LANE;
+        default:
+            return NORMAL_LANE;
+        }
+    }
+
+    // The event held, for dispatch.
+    Event & event()
+    {
+        switch (m_kind)
+        {
+        case BOUNDARY_EVENT:
+            return m_boundary;
+        case CONTACT_EVENT:
+            return m_contact;
+        case ENCODER_EVENT:
+            return m_encoder;
+        case PROXIMITY_EVENT:
+            return m_proximity;
+        case START_EVENT:
+            return m_start;
+        case TIMER_EVENT:
+            return m_timer;
+        default:
+            return m_event;
+        }
+    }
+
+private:
+    static uint8_t const NO_EVENT = 0xFF;
+
+    uint8_t m_kind;
+    union
+    {
+        Event m_event;
+        BoundaryEvent m_boundary;
+        ContactEvent m_contact;
+        EncoderEvent m_encoder;
+        ProximityEvent m_proximity;
+        StartButtonEvent m_start;
+        TimerEvent m_timer;
+    };
 };
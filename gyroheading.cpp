@@ -0,0 +1,60 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include "gyroheading.h"
+
+GyroHeading::GyroHeading()
+{
+    reset();
+}
+
+void GyroHeading::reset()
+{
+    m_heading = 0;
+    m_bias = 0;
+    m_rate = 0;
+    m_bias_shift = 0;
+    m_bias_samples = 0;
+}
+
+void GyroHeading::update(int16_t z, bool still)
+{
+    if (still)
+    {
+        // With shift n after 2^n samples, the bias is close to their mean.
+        m_bias += ((static_cast<int32_t>(z) << 8) - m_bias) >> m_bias_shift;
+        if (
+            m_bias_shift < GYRO_BIAS_SHIFT &&
+            ++m_bias_samples >= (1U << m_bias_shift)
+        )
+        {
+            ++m_bias_shift;
+            m_bias_samples = 0;
+        }
+    }
+
+    // Rate in 24.8 counts. The whole and fractional counts are scaled
+    // separately, so neither product overflows.
+    m_rate = (static_cast<int32_t>(z) << 8) - m_bias;
+    int32_t const change =
+        (m_rate >> 8) * PER_COUNT + ((m_rate & 0xFF) * PER_COUNT >> 8);
+    m_heading += static_cast<uint32_t>(change);
+}
+
+uint32_t GyroHeading::heading() const
+{
+    return m_heading;
+}
+
+int16_t GyroHeading::rate() const
+{
+    return (m_rate >> 8) * GYRO_MDPS_PER_COUNT / 1000;
+}
+
+int32_t GyroHeading::bias() const
+{
+    return m_bias;
+}
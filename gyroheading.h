@@ -0,0 +1,90 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "imufifo.h"
+
+// Gyro sensitivity at +/-2000 degrees per second full scale, in thousandths
+// of a degree per second per count.
+#ifndef GYRO_MDPS_PER_COUNT
+#define GYRO_MDPS_PER_COUNT 70
+#endif
+
+// Bias filter shift: while the robot is still, each sample moves the bias
+// 1 / 2^shift of the way to it. At 200 samples per second (see GYRO_RATE),
+// the bias follows over about 1.3 s.
+#ifndef GYRO_BIAS_SHIFT
+#define GYRO_BIAS_SHIFT 8
+#endif
+
+// Time after the robot's motor command last changed before `IRobot` counts
+// it as still, for the bias, if its encoders have not moved either. Longer
+// than CONTACT_SETTLE_MS, since the robot must have stopped turning
+// altogether, not only settled to a steady speed.
+#ifndef GYRO_STILL_MS
+#define GYRO_STILL_MS 500
+#endif
+
+// Heading integrated from the gyro's yaw rate.
+//
+// Takes the gyro's z axis (counterclockwise positive) in raw counts, one
+// FIFO sample at a time. Samples come at the gyro's own fixed rate, so each
+// adds its rate times a constant sample period: one multiply, and no clock
+// reads or timing jitter. Unlike encoder counts, the heading does not
+// overstate the turn when the treads slip.
+//
+// The gyro's zero rate output is several degrees per second, so the bias is
+// measured while the robot is still, and taken out of every sample. The
+// first samples are averaged (the filter starts fast, then slows down to
+// GYRO_BIAS_SHIFT), so a bias is known a fraction of a second after start
+// up.
+//
+// The heading is in 12.20 fixed point degrees, counterclockwise, unsigned so
+// that it wraps every 4096 degrees without overflow. The difference between
+// two headings, taken as `static_cast<int32_t>(a - b)`, is right as long as
+// it is under 2048 degrees either way.
+class GyroHeading
+{
+public:
+    // One degree of heading.
+    static int32_t const ONE_DEGREE = 1L << 20;
+
+    GyroHeading();
+
+    // Zero the heading, and forget the bias.
+    void reset();
+
+    // Update from one sample. `still` is whether the robot is known not to
+    // be turning, so the sample is all bias.
+    void update(int16_t z, bool still);
+
+    // Heading since `reset()`, modulo 4096 degrees.
+    uint32_t heading() const;
+
+    // Yaw rate at the last sample, less the bias, in degrees per second.
+    int16_t rate() const;
+
+    // Bias, in 24.8 fixed point counts.
+    int32_t bias() const;
+
+private:
+    // Sample period set by GYRO_RATE.
+    static uint32_t const SAMPLE_US = 10000UL >> GYRO_RATE;
+
+    // Heading change of one count for one sample period.
+    static int32_t const PER_COUNT = static_cast<int32_t>(
+        static_cast<uint64_t>(GYRO_MDPS_PER_COUNT) * SAMPLE_US *
+        ONE_DEGREE / 1000000000ULL
+    );
+
+    uint32_t m_heading;
+    int32_t m_bias;
+    int32_t m_rate;
+    uint8_t m_bias_shift;
+    uint16_t m_bias_samples;
+};
@@ -0,0 +1,171 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include <algorithm>
+#include <math.h>
+#include "arena.h"
+
+namespace sim
+{
+    static void drive(Body & body, double dt_s)
+    {
+        double const left = body.motor_left * MM_PER_S_PER_SPEED;
+        double const right = body.motor_right * MM_PER_S_PER_SPEED;
+        double const v = (left + right) / 2;
+        double const w = (right - left) / TRACK_MM;
+
+        body.heading += w * dt_s;
+        body.x += v * cos(body.heading) * dt_s;
+        body.y += v * sin(body.heading) * dt_s;
+    }
+
+    Arena::Arena()
+    {
+        robot = Body{-150.0, 0.0, 0.0, 0, 0};
+        opponent = Body{150.0, 0.0, M_PI, 0, 0};
+    }
+
+    void Arena::step(double dt_s)
+    {
+        drive(robot, dt_s);
+        drive(opponent, dt_s);
+
+        // Push apart equally along the line between centres.
+        double const dx = opponent.x - robot.x;
+        double const dy = opponent.y - robot.y;
+        double const d = sqrt(dx * dx + dy * dy);
+        double const overlap = 2 * BODY_RADIUS_MM - d;
+        if (overlap > 0 && d > 0)
+        {
+            double const nx = dx / d * overlap / 2;
+            double const ny = dy / d * overlap / 2;
+            robot.x -= nx;
+            robot.y -= ny;
+            opponent.x += nx;
+            opponent.y += ny;
+        }
+    }
+
+    bool Arena::out(Body const & body)
+    {
+        return body.x * body.x + body.y * body.y >
+            RING_RADIUS_MM * RING_RADIUS_MM;
+    }
+
+    bool Arena::touching() const
+    {
+        return gap(robot, opponent) <= 0.5;
+    }
+
+    double Arena::gap(Body const & self, Body const & other)
+    {
+        return hypot(other.x - self.x, other.y - self.y) - 2 * BODY_RADIUS_MM;
+    }
+
+    double Arena::bearing(Body const & self, Body const & other)
+    {
+        double const a =
+            atan2(other.y - self.y, other.x - self.x) - self.heading;
+        return atan2(sin(a), cos(a));
+    }
+
+    void Arena::line_sensor_position(
+        Body const & self,
+        unsigned int i,
+        double & x,
+        double & y
+    )
+    {
+        double const forward = BODY_RADIUS_MM - 8;
+        double const left = 40.0 - 20.0 * i;
+        double const c = cos(self.heading);
+        double const s = sin(self.heading);
+
+        x = self.x + forward * c - left * s;
+        y = self.y + forward * s + left * c;
+    }
+
+    void Arena::sense(
+        Body const & self,
+        Body const & other,
+        Hardware & hw,
+        uint32_t & seed
+    )
+    {
+        // Line sensors across the front edge.
+        for (unsigned int i = 0; i < 5; ++i)
+        {
+            double x;
+            double y;
+            line_sensor_position(self, i, x, y);
+            double const r = sqrt(x * x + y * y);
+
+            if (r > RING_RADIUS_MM)
+            {
+                // Over the edge. Nothing reflects.
+                hw.line[i] = 2000;
+                continue;
+            }
+
+            // Fraction of the footprint over the border.
+            double white = (r - (RING_RADIUS_MM - BORDER_MM)) /
+                LINE_FOOTPRINT_MM + 0.5;
+            white = white < 0 ? 0 : white > 1 ? 1 : white;
+            double black_reading = 1500 + next(seed) % 500;
+            if (next(seed) % LINE_GLARE_ODDS == 0)
+            {
+                black_reading = 200 + next(seed) % 500;
+            }
+            double const white_reading = 100 + next(seed) % 100;
+            hw.line[i] = static_cast<unsigned int>(
+                black_reading * (1 - white) + white_reading * white
+            );
+        }
+
+        // Front proximity sensor. Brightness rises as the opponent closes, and
+        // is stronger on the side lit by the LEDs nearest it, more so the
+        // further off centre the opponent is.
+        double const g = gap(self, other);
+        double const b = bearing(self, other);
+        uint8_t range_level = 0;
+        if (g < PROXIMITY_RANGE_MM)
+        {
+            range_level = static_cast<uint8_t>(
+                ceil(6.0 * (1.0 - (g > 0 ? g : 0) / PROXIMITY_RANGE_MM))
+            );
+        }
+        uint8_t const level =
+            fabs(b) < PROXIMITY_HALF_ANGLE ? range_level : 0;
+        uint8_t const dim = static_cast<uint8_t>(std::min<double>(
+            level,
+            floor(fabs(b) / PROXIMITY_HALF_ANGLE * PROXIMITY_BEARING_COUNTS +
+                0.5)
+        ));
+        uint8_t left = level;
+        uint8_t right = level;
+        if (b > 0)
+        {
+            right -= dim;
+        }
+        else
+        {
+            left -= dim;
+        }
+        if (!level && next(seed) % PROXIMITY_NOISE_ODDS == 0)
+        {
+            uint8_t const noise = next(seed) % 20 ? 1 : 2;
+            (next(seed) & 1 ? left : right) = noise;
+        }
+        hw.proximity_front_left = left;
+        hw.proximity_front_right = right;
+
+        // Side sensors, lit by the LEDs on their own side.
+        hw.proximity_left =
+            fabs(b - M_PI / 2) < SIDE_PROXIMITY_HALF_ANGLE ? range_level : 0;
+        hw.proximity_right =
+            fabs(b + M_PI / 2) < SIDE_PROXIMITY_HALF_ANGLE ? range_level : 0;
+    }
+}
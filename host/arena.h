@@ -0,0 +1,110 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "sim.h"
+
+// Two-robot sumo ring, for match simulation.
+//
+// Robots are discs with differential (tread) drive. Each tread moves at a
+// speed proportional to its motor command, at the same rate the `Hardware`
+// wheel model counts encoder ticks. Robots that overlap are pushed apart
+// equally, so with equal mass the one driving harder into the other moves
+// both, and robots pushing head on at equal speed stall.
+//
+// Positions are in millimetres from the ring centre, headings in radians
+// anticlockwise from the x axis.
+namespace sim
+{
+    // Mini sumo ring: 77 cm diameter, with a 2.5 cm white border.
+    double const RING_RADIUS_MM = 385.0;
+    double const BORDER_MM = 25.0;
+
+    // Zumo 32U4 footprint, and tread spacing (centre to centre).
+    double const BODY_RADIUS_MM = 48.0;
+    double const TRACK_MM = 88.0;
+
+    // Tread speed per unit of motor speed: 12.5 encoder counts per second
+    // (the `Hardware` default, a 75:1 Zumo) at 7.5 counts per millimetre
+    // (900 counts per revolution of a 38 mm wheel).
+    double const COUNTS_PER_MM = 7.5;
+    double const MM_PER_S_PER_SPEED = 12.5 / COUNTS_PER_MM;
+
+    // Line sensor readings. Black reads 1500 to 2000 and white 100 to 200. A
+    // sensor whose footprint straddles the edge of the border reads in
+    // between. About one black reading in LINE_GLARE_ODDS reads 200 to 700
+    // instead (dust, scuffs or glare).
+    double const LINE_FOOTPRINT_MM = 6.0;
+    uint32_t const LINE_GLARE_ODDS = 2000;
+
+    // Proximity sensor range, and field of view of the front sensor (either
+    // side of centre) and of the side sensors (either side of square to the
+    // robot's heading).
+    double const PROXIMITY_RANGE_MM = 400.0;
+    double const PROXIMITY_HALF_ANGLE = 0.6;
+    double const SIDE_PROXIMITY_HALF_ANGLE = 1.0;
+
+    // The front sensor reads the opponent dimmer with the LEDs on the side
+    // away from it, by up to this many counts at the edge of its field of
+    // view.
+    double const PROXIMITY_BEARING_COUNTS = 3.0;
+
+    // About one front proximity read in PROXIMITY_NOISE_ODDS sees a count of
+    // 1 on one side from ambient IR with no opponent, and one in 20 times as
+    // many a count of 2.
+    uint32_t const PROXIMITY_NOISE_ODDS = 100;
+
+    struct Body
+    {
+        double x;
+        double y;
+        double heading;
+        int16_t motor_left;
+        int16_t motor_right;
+    };
+
+    class Arena
+    {
+    public:
+        Arena();
+
+        // Advance both robots by `dt_s` seconds.
+        void step(double dt_s);
+
+        // Centre outside the ring.
+        static bool out(Body const & body);
+
+        bool touching() const;
+
+        // Distance between the robots' edges, and bearing of `other` from
+        // `self`, relative to its heading (positive => to the left).
+        static double gap(Body const & self, Body const & other);
+        static double bearing(Body const & self, Body const & other);
+
+        // Floor position of line sensor `i` (0 through 4, left to right) of
+        // `self`.
+        static void line_sensor_position(
+            Body const & self,
+            unsigned int i,
+            double & x,
+            double & y
+        );
+
+        // Fill in the line sensor and proximity readings `self` would see
+        // into `hw`. `seed` drives the sensor noise.
+        static void sense(
+            Body const & self,
+            Body const & other,
+            Hardware & hw,
+            uint32_t & seed
+        );
+
+        Body robot;
+        Body opponent;
+    };
+}
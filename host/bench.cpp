@@ -0,0 +1,440 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// Loop throughput benchmark.
+//
+// Runs the sketch's `setup()` and `loop()` against the simulated hardware as
+// fast as the host allows, with a deterministic stream of sensor input, and
+// reports loops per second, event dispatches per second, and per-loop latency
+// percentiles.
+//
+// Usage: bench [loops]
+
+#include <algorithm>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "eventqueue.h"
+#include "robot.h"
+#include "robotstatemachine.h"
+#include "sim.h"
+#include "timerwheel.h"
+#include "trace.h"
+
+// Defined in sumobot-template.ino.
+extern IRobot robot;
+extern RobotStateMachine machine;
+void setup();
+void loop();
+
+typedef std::chrono::steady_clock Clock;
+
+// Deterministic sensor input. Mostly ring, with occasional boundary crossings,
+// a noisy opponent, and a start button press shortly after power up.
+class Scenario
+{
+public:
+    explicit Scenario(uint32_t seed) : m_seed(seed), m_loop(0) {}
+
+    void step(sim::Hardware & hw)
+    {
+        hw.start_button = m_loop >= 10 && m_loop < 20;
+
+        // Start pressed while over the boundary, then random crossings.
+        bool boundary = m_loop == 10 || next() % 64 == 0;
+        unsigned int side = next() % 3;
+        for (unsigned int i = 0; i < 5; ++i)
+        {
+            bool white = boundary && (side == 1 || i / 2 == side);
+            hw.line[i] = white ? 100 + next() % 100 : 1500 + next() % 500;
+        }
+
+        uint8_t opponent = next() % 7;
+        hw.proximity_front_left = opponent ? opponent - next() % 2 : 0;
+        hw.proximity_front_right = opponent ? opponent - next() % 2 : 0;
+
+        ++m_loop;
+    }
+
+private:
+    uint32_t next()
+    {
+        return sim::next(m_seed);
+    }
+
+    uint32_t m_seed;
+    unsigned long m_loop;
+};
+
+struct Stats
+{
+    double seconds;
+    unsigned long loops;
+    unsigned long dispatches;
+    std::vector<uint32_t> latency_ns;
+
+    // Virtual time from boundary sensor read to boundary event dispatch, and
+    // to the motor write committed after handling it, if any.
+    unsigned long boundary_dispatches;
+    unsigned long boundary_dispatch_us_sum;
+    unsigned long boundary_dispatch_us_max;
+    unsigned long boundary_motor_writes;
+    unsigned long boundary_motor_us_max;
+
+    // Longest virtual (modelled MCU) time of a single loop.
+    unsigned long loop_us_max;
+};
+
+static void report(char const * name, Stats & stats)
+{
+    std::sort(stats.latency_ns.begin(), stats.latency_ns.end());
+    size_t const n = stats.latency_ns.size();
+    double const percentiles[] = {50.0, 90.0, 99.0, 99.9};
+
+    printf("%s\n", name);
+    printf("  loops/sec:      %12.0f\n", stats.loops / stats.seconds);
+    if (stats.dispatches)
+    {
+        printf("  dispatches/sec: %12.0f\n", stats.dispatches / stats.seconds);
+        printf(
+            "  dispatches/loop:%12.2f\n",
+            static_cast<double>(stats.dispatches) / stats.loops
+        );
+    }
+    for (double p : percentiles)
+    {
+        size_t idx = static_cast<size_t>(p / 100.0 * (n - 1));
+        printf("  p%-5g ns:      %12u\n", p, stats.latency_ns[idx]);
+    }
+    printf("  max ns:         %12u\n", stats.latency_ns[n - 1]);
+    if (stats.loop_us_max)
+    {
+        printf("  longest modelled loop: %lu us\n", stats.loop_us_max);
+    }
+    if (stats.boundary_dispatches)
+    {
+        printf(
+            "  boundary read to dispatch: mean %.0f us, max %lu us\n",
+            static_cast<double>(stats.boundary_dispatch_us_sum) /
+                stats.boundary_dispatches,
+            stats.boundary_dispatch_us_max
+        );
+        if (stats.boundary_motor_writes)
+        {
+            printf(
+                "  boundary read to motor write: max %lu us\n",
+                stats.boundary_motor_us_max
+            );
+        }
+        else
+        {
+            printf("  boundary read to motor write: no motor response\n");
+        }
+    }
+}
+
+// Time `loop()` exactly as the sketch runs it.
+static Stats run_loop(unsigned long loops)
+{
+    Stats stats = {0.0, loops, 0, std::vector<uint32_t>(loops), 0, 0, 0, 0, 0, 0};
+    Scenario scenario(1);
+    sim::Hardware & hw = sim::hardware();
+
+    Clock::time_point const start = Clock::now();
+    for (unsigned long i = 0; i < loops; ++i)
+    {
+        scenario.step(hw);
+        Clock::time_point const t0 = Clock::now();
+        loop();
+        Clock::time_point const t1 = Clock::now();
+        stats.latency_ns[i] = static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()
+        );
+    }
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    return stats;
+}
+
+static void dispatch_boundary(
+    RobotEventSlot & slot,
+    sim::Hardware const & hw,
+    Stats & stats
+)
+{
+    unsigned long const latency_us = sim::now_us() - hw.line_read_us;
+
+    machine.handle_event(slot.event());
+
+    ++stats.boundary_dispatches;
+    stats.boundary_dispatch_us_sum += latency_us;
+    stats.boundary_dispatch_us_max =
+        std::max(stats.boundary_dispatch_us_max, latency_us);
+}
+
+// Same work as `loop()`, with the queue drain open-coded so dispatches can be
+// counted. Keep in step with `loop()` in sumobot-template.ino.
+static Stats run_counted(unsigned long loops)
+{
+    Stats stats = {0.0, loops, 0, std::vector<uint32_t>(loops), 0, 0, 0, 0, 0, 0};
+    Scenario scenario(1);
+    sim::Hardware & hw = sim::hardware();
+
+    Clock::time_point const start = Clock::now();
+    for (unsigned long i = 0; i < loops; ++i)
+    {
+        scenario.step(hw);
+        unsigned long const loop_start_us = sim::now_us();
+        Clock::time_point const t0 = Clock::now();
+        robot.generate_events();
+        bool boundary = false;
+        while (RobotEventSlot * slot = robot.events().front())
+        {
+            TRACE_EVENT(*slot);
+            if (slot->kind() == BOUNDARY_EVENT)
+            {
+                dispatch_boundary(*slot, hw, stats);
+                boundary = true;
+            }
+            else
+            {
+                machine.handle_event(slot->event());
+            }
+            robot.events().pop();
+            ++stats.dispatches;
+        }
+        unsigned long const motor_writes = hw.motor_writes;
+        robot.commit_motors();
+        if (boundary && hw.motor_writes != motor_writes)
+        {
+            ++stats.boundary_motor_writes;
+            stats.boundary_motor_us_max = std::max(
+                stats.boundary_motor_us_max,
+                hw.motor_write_us - hw.line_read_us
+            );
+        }
+        robot.update_display();
+        Clock::time_point const t1 = Clock::now();
+        stats.loop_us_max =
+            std::max(stats.loop_us_max, sim::now_us() - loop_start_us);
+        stats.latency_ns[i] = static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()
+        );
+    }
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    return stats;
+}
+
+// Timestamp counter ticks, where the host has one.
+static uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Cost of `handle_event()` alone, per event kind, in the machine's current
+// state.
+static void report_dispatch(unsigned long iterations)
+{
+    RobotEventSlot const slots[] = {
+        BoundaryEvent(AHEAD),
+        EncoderEvent(),
+        ProximityEvent(LEFT, 3, 1),
+        StartButtonEvent(),
+        TimerEvent()
+    };
+
+    printf("handle_event() in state '%s'\n", machine.active_state_name());
+    for (RobotEventSlot slot : slots)
+    {
+        Event & event = slot.event();
+        bool const handled = machine.handle_event(event) == OK;
+        Clock::time_point const start = Clock::now();
+        uint64_t const start_cycles = cycles();
+        for (unsigned long i = 0; i < iterations; ++i)
+        {
+            machine.handle_event(event);
+        }
+        uint64_t const elapsed_cycles = cycles() - start_cycles;
+        double const ns = std::chrono::duration<double, std::nano>(
+            Clock::now() - start
+        ).count();
+        printf(
+            "  %-6s %-9s %8.2f ns %8.2f cycles\n",
+            event.m_name,
+            handled ? "handled" : "unhandled",
+            ns / iterations,
+            static_cast<double>(elapsed_cycles) / iterations
+        );
+    }
+}
+
+// Cost of advancing a timer wheel one millisecond against the number of
+// running timers, and worst case lateness of expirations. Timeouts are long
+// enough that about one timer expires, and is restarted, per millisecond.
+// Starts near the millis() wraparound, so deadlines cross it.
+static void report_timers(unsigned long iterations)
+{
+    unsigned int const counts[] = {1, 8, 32, 64};
+
+    printf("timer wheel expire() + restarts, 1 ms per call\n");
+    for (unsigned int count : counts)
+    {
+        TimerWheel<64, 16> wheel;
+        unsigned long now_ms = static_cast<unsigned long>(-1000);
+        wheel.reset(now_ms);
+
+        unsigned long deadlines[64];
+        for (unsigned int id = 0; id < count; ++id)
+        {
+            unsigned long const timeout_ms = 1 + id;
+            deadlines[id] = now_ms + timeout_ms;
+            wheel.start(id, now_ms, timeout_ms);
+        }
+
+        uint8_t expired[64];
+        unsigned long fired = 0;
+        unsigned long max_late_ms = 0;
+        Clock::time_point const start = Clock::now();
+        for (unsigned long i = 0; i < iterations; ++i)
+        {
+            ++now_ms;
+            uint8_t n = 0;
+            wheel.expire(now_ms, [&](uint8_t id) { expired[n++] = id; });
+
+            for (uint8_t j = 0; j < n; ++j)
+            {
+                uint8_t const id = expired[j];
+                max_late_ms = std::max(max_late_ms, now_ms - deadlines[id]);
+                deadlines[id] = now_ms + count;
+                wheel.start(id, now_ms, count);
+            }
+            fired += n;
+        }
+        double const ns = std::chrono::duration<double, std::nano>(
+            Clock::now() - start
+        ).count();
+        printf(
+            "  %2u running: %6.2f ns per ms, %lu expired, max %lu ms late\n",
+            count,
+            ns / iterations,
+            fired,
+            max_late_ms
+        );
+    }
+}
+
+// Motor writes for state changes that stop in `on_exit()` and drive off in
+// `on_entry()`, alternating direction, on a robot of its own.
+static void report_motor_commit(unsigned long changes)
+{
+    sim::Hardware hw;
+    sim::Hardware & previous = sim::hardware();
+    sim::select(hw);
+    IRobot bot;
+    bot.setup();
+
+    for (unsigned long i = 0; i < changes; ++i)
+    {
+        bot.stop();
+        bot.move(i & 1 ? -200 : 200);
+        bot.commit_motors();
+    }
+    printf(
+        "motor commit, %lu exit/entry changes: %lu commands, %lu writes\n",
+        changes,
+        bot.motor_commands(),
+        bot.motor_writes()
+    );
+
+    sim::select(previous);
+}
+
+int main(int argc, char ** argv)
+{
+    unsigned long const loops = argc > 1 ? strtoul(argv[1], nullptr, 0) : 1000000;
+    if (!loops)
+    {
+        fprintf(stderr, "usage: %s [loops]\n", argv[0]);
+        return 1;
+    }
+
+    setup();
+
+    // The counted run goes first, so it sees the start button press take
+    // the machine out of its initial state.
+    Stats counted = run_counted(loops);
+    unsigned long const sim_start_us = sim::now_us();
+    Stats looped = run_loop(loops);
+    unsigned long const sim_loop_us = sim::now_us() - sim_start_us;
+
+    printf("loops: %lu\n", loops);
+    printf(
+        "modelled MCU I/O time per loop: %.1f us\n",
+        static_cast<double>(sim_loop_us) / loops
+    );
+    printf("final state: %s\n", machine.active_state_name());
+    printf("LCD: '%s' '%s'\n", sim::hardware().lcd[0], sim::hardware().lcd[1]);
+    report("loop()", looped);
+    report("loop() with dispatch counting", counted);
+    for (uint8_t i = 0; i < LANE_COUNT; ++i)
+    {
+        printf(
+            "event queue lane %u: %u slots, high water mark %u, %u dropped\n",
+            i,
+            QUEUE_SIZE,
+            robot.events().lane(i).high_water_mark(),
+            robot.events().lane(i).dropped()
+        );
+    }
+    printf(
+        "dispatches saved: %lu suppressed by event policy, %lu coalesced\n",
+        robot.suppressed_events(),
+        robot.events().coalesced()
+    );
+    char const * const sensor_names[SENSOR_COUNT] = {
+        "button", "line", "encoders", "proximity", "accel", "gyro"
+    };
+    SensorScheduler const & sensors = robot.sensor_schedule();
+    printf("sensor reads (modelled time, both runs)\n");
+    for (uint8_t i = 0; i < SENSOR_COUNT; ++i)
+    {
+        printf(
+            "  %-10s %8lu reads/s, mean %5lu us, max %5lu us\n",
+            sensor_names[i],
+            sensors.sample_rate(i),
+            sensors.mean_read_us(i),
+            sensors.max_read_us(i)
+        );
+    }
+    printf(
+        "motor commands: %lu issued, %lu written\n",
+        robot.motor_commands(),
+        robot.motor_writes()
+    );
+    report_dispatch(loops);
+    report_timers(loops);
+    report_motor_commit(1000);
+    printf(
+        "host footprint: %zu bytes per event slot, %zu bytes per queue, "
+        "%zu bytes per robot, %zu bytes per machine\n",
+        sizeof(RobotEventSlot),
+        sizeof(EventQueue),
+        sizeof(IRobot),
+        sizeof(RobotStateMachine)
+    );
+
+    return 0;
+}
@@ -0,0 +1,433 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// Boundary classifier benchmark.
+//
+// Generates line sensor readings from random poses in the simulated ring of
+// arena.h, near the border and away from it, with a different gain on each
+// sensor (as real sensors vary), and labels each with the direction the
+// sensors actually over the border give. Reports, for three and five
+// sensors, with the shared threshold and calibrated per sensor, how often
+// the classifier agrees with the label, misses a border, reports a border
+// that is not there, or gets its direction wrong, and the host cycles per
+// classification, against the branch chain `IRobot` used before. Samples
+// with a sensor whose footprint straddles the edge of the border, or that is
+// past the edge of the ring, have no clear label, and are left out of the
+// scores.
+//
+// Calibration sees a separate set of readings, as spinning in place on the
+// border would.
+//
+// With a sensor log (see sensorlog.h), also calibrates on the log and reports
+// how many of its records each classifier puts over the border. Recorded
+// logs carry no labels, so only the counts can be compared.
+//
+// Usage: boundarybench [samples] [sensor log]
+
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "arena.h"
+#include "boundaryclassifier.h"
+#include "robotconfig.h"
+#include "sensorlog.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// Gain of each line sensor, left to right. The three sensor configuration
+// uses sensors 0, 2 and 4.
+double const SENSOR_GAINS[5] = {1.3, 0.9, 0.6, 1.0, 1.25};
+
+unsigned long const CALIBRATION_SAMPLES = 5000;
+
+struct Sample
+{
+    unsigned int line[5];
+    // Sensors over the border, bit `i` for sensor `i`.
+    uint8_t truth;
+    // Sensors without a clear label.
+    uint8_t unlabelled;
+};
+
+struct Score
+{
+    unsigned long samples;
+    unsigned long correct;
+    unsigned long missed;
+    unsigned long false_boundary;
+    unsigned long wrong_direction;
+};
+
+// Readings from a random pose: half with the sensors near the border, half
+// well inside the ring.
+static Sample sample(uint32_t & seed, sim::Hardware & hw)
+{
+    double const edge = sim::RING_RADIUS_MM - sim::BORDER_MM;
+    double const r = sim::next(seed) & 1 ?
+        sim::uniform(seed, edge - 70, edge + 10) :
+        sim::uniform(seed, 0, edge - 100);
+    double const angle = sim::uniform(seed, -M_PI, M_PI);
+    sim::Body const self = {
+        r * cos(angle),
+        r * sin(angle),
+        sim::uniform(seed, -M_PI, M_PI),
+        0,
+        0
+    };
+    sim::Body const other = {-self.x, -self.y, 0, 0, 0};
+    sim::Arena::sense(self, other, hw, seed);
+
+    Sample s;
+    s.truth = 0;
+    s.unlabelled = 0;
+    for (unsigned int i = 0; i < 5; ++i)
+    {
+        double const value = hw.line[i] * SENSOR_GAINS[i];
+        s.line[i] = value > sim::LINE_SENSOR_TIMEOUT_US ?
+            sim::LINE_SENSOR_TIMEOUT_US : static_cast<unsigned int>(value);
+
+        double x;
+        double y;
+        sim::Arena::line_sensor_position(self, i, x, y);
+        double const d = hypot(x, y) - edge;
+        if (d > 0)
+        {
+            s.truth |= 1 << i;
+        }
+        if (
+            fabs(d) < sim::LINE_FOOTPRINT_MM / 2 ||
+            d > sim::BORDER_MM - sim::LINE_FOOTPRINT_MM / 2
+        )
+        {
+            s.unlabelled |= 1 << i;
+        }
+    }
+
+    return s;
+}
+
+// The readings of the sensors a configuration uses.
+// Returns `false` if any of them has no clear label.
+static bool select_sensors(
+    Sample const & s,
+    uint8_t sensors,
+    unsigned int * values,
+    uint8_t & truth
+)
+{
+    bool clear = true;
+    truth = 0;
+    for (uint8_t i = 0; i < sensors; ++i)
+    {
+        uint8_t const sensor = sensors == 3 ? i * 2 : i;
+        values[i] = s.line[sensor];
+        truth |= ((s.truth >> sensor) & 1) << i;
+        clear = clear && !((s.unlabelled >> sensor) & 1);
+    }
+    return clear;
+}
+
+// `IRobot::boundary_detect()` before the classifier: three sensors, one
+// threshold, a chain of branches.
+static Boundary branch_chain(
+    unsigned int const * values,
+    unsigned int threshold
+)
+{
+    bool left_boundary = values[0] < threshold;
+    bool center_boundary = values[1] < threshold;
+    bool right_boundary = values[2] < threshold;
+
+    Boundary boundary = NO_BOUNDARY;
+    if (center_boundary || (left_boundary && right_boundary))
+    {
+        boundary = BOUNDARY_AHEAD;
+    }
+    else if (left_boundary)
+    {
+        boundary = BOUNDARY_LEFT;
+    }
+    else if (right_boundary)
+    {
+        boundary = BOUNDARY_RIGHT;
+    }
+
+    return boundary;
+}
+
+static void tally(Score & score, Boundary got, Boundary expected)
+{
+    ++score.samples;
+    if (got == expected)
+    {
+        ++score.correct;
+    }
+    else if (got == NO_BOUNDARY)
+    {
+        ++score.missed;
+    }
+    else if (expected == NO_BOUNDARY)
+    {
+        ++score.false_boundary;
+    }
+    else
+    {
+        ++score.wrong_direction;
+    }
+}
+
+static uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+template <uint8_t SENSORS>
+static Score score(
+    BoundaryClassifier<SENSORS> const & classifier,
+    std::vector<Sample> const & samples
+)
+{
+    Score s = {0, 0, 0, 0, 0};
+    for (Sample const & sample : samples)
+    {
+        unsigned int values[SENSORS];
+        uint8_t truth;
+        if (!select_sensors(sample, SENSORS, values, truth))
+        {
+            continue;
+        }
+        tally(
+            s,
+            classifier.classify(values),
+            BoundaryClassifier<SENSORS>::direction(truth)
+        );
+    }
+    return s;
+}
+
+static void print_score(char const * name, Score const & s)
+{
+    printf(
+        "  %-26s %8lu %8.3f %8.3f %8.3f %8.3f\n",
+        name,
+        s.samples,
+        100.0 * s.correct / s.samples,
+        100.0 * s.missed / s.samples,
+        100.0 * s.false_boundary / s.samples,
+        100.0 * s.wrong_direction / s.samples
+    );
+}
+
+// Time `classify(values)` over every sample, `passes` times. Prints cycles
+// and nanoseconds per classification.
+template <uint8_t SENSORS, typename F>
+static void time_classifier(
+    char const * name,
+    std::vector<Sample> const & samples,
+    unsigned int passes,
+    F classify
+)
+{
+    std::vector<unsigned int> values(samples.size() * SENSORS);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        uint8_t truth;
+        select_sensors(samples[i], SENSORS, &values[i * SENSORS], truth);
+    }
+
+    unsigned long sum = 0;
+    Clock::time_point const start = Clock::now();
+    uint64_t const start_cycles = cycles();
+    for (unsigned int pass = 0; pass < passes; ++pass)
+    {
+        for (size_t i = 0; i < samples.size(); ++i)
+        {
+            sum += classify(&values[i * SENSORS]);
+        }
+    }
+    uint64_t const elapsed_cycles = cycles() - start_cycles;
+    double const seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    double const n = static_cast<double>(samples.size()) * passes;
+
+    printf(
+        "  %-26s %8.1f %8.2f   (checksum %lu)\n",
+        name,
+        elapsed_cycles / n,
+        seconds * 1e9 / n,
+        sum
+    );
+}
+
+// Records of `log` each classifier puts over the border.
+static void report_log(char const * path, RobotConfig const & config)
+{
+    sim::SensorLog log;
+    if (!log.open(path))
+    {
+        return;
+    }
+
+    BoundaryClassifier<3> shared3;
+    BoundaryClassifier<5> shared5;
+    BoundaryClassifier<3> calibrated3;
+    BoundaryClassifier<5> calibrated5;
+    shared3.configure(config.boundary_threshold, config.boundary_fraction);
+    shared5.configure(config.boundary_threshold, config.boundary_fraction);
+    calibrated3.configure(config.boundary_threshold, config.boundary_fraction);
+    calibrated5.configure(config.boundary_threshold, config.boundary_fraction);
+
+    std::vector<Sample> samples(log.size());
+    for (size_t i = 0; i < log.size(); ++i)
+    {
+        for (unsigned int j = 0; j < 5; ++j)
+        {
+            samples[i].line[j] = log[i].line[j];
+        }
+        samples[i].truth = 0;
+        samples[i].unlabelled = 0;
+
+        unsigned int values[5];
+        uint8_t truth;
+        select_sensors(samples[i], 3, values, truth);
+        calibrated3.calibrate(values);
+        select_sensors(samples[i], 5, values, truth);
+        calibrated5.calibrate(values);
+    }
+
+    // With no labels, every reported border counts as a false boundary.
+    printf("\n%s: %zu records, %% over the border\n", path, log.size());
+    Score const s3 = score(shared3, samples);
+    Score const c3 = score(calibrated3, samples);
+    Score const s5 = score(shared5, samples);
+    Score const c5 = score(calibrated5, samples);
+    printf("  3 sensors, shared          %8.3f\n",
+        100.0 * s3.false_boundary / s3.samples);
+    printf("  3 sensors, calibrated      %8.3f\n",
+        100.0 * c3.false_boundary / c3.samples);
+    printf("  5 sensors, shared          %8.3f\n",
+        100.0 * s5.false_boundary / s5.samples);
+    printf("  5 sensors, calibrated      %8.3f\n",
+        100.0 * c5.false_boundary / c5.samples);
+}
+
+int main(int argc, char ** argv)
+{
+    unsigned long const count =
+        argc > 1 ? strtoul(argv[1], nullptr, 0) : 200000;
+    RobotConfig const config;
+    sim::Hardware hw;
+    uint32_t seed = 1;
+
+    std::vector<Sample> calibration(CALIBRATION_SAMPLES);
+    for (Sample & s : calibration)
+    {
+        s = sample(seed, hw);
+    }
+    std::vector<Sample> samples(count);
+    for (Sample & s : samples)
+    {
+        s = sample(seed, hw);
+    }
+
+    BoundaryClassifier<3> shared3;
+    BoundaryClassifier<5> shared5;
+    BoundaryClassifier<3> calibrated3;
+    BoundaryClassifier<5> calibrated5;
+    shared3.configure(config.boundary_threshold, config.boundary_fraction);
+    shared5.configure(config.boundary_threshold, config.boundary_fraction);
+    calibrated3.configure(config.boundary_threshold, config.boundary_fraction);
+    calibrated5.configure(config.boundary_threshold, config.boundary_fraction);
+    for (Sample const & s : calibration)
+    {
+        unsigned int values[5];
+        uint8_t truth;
+        select_sensors(s, 3, values, truth);
+        calibrated3.calibrate(values);
+        select_sensors(s, 5, values, truth);
+        calibrated5.calibrate(values);
+    }
+
+    printf(
+        "%lu samples, sensor gains %.2f %.2f %.2f %.2f %.2f, shared "
+        "threshold %u\n",
+        count,
+        SENSOR_GAINS[0],
+        SENSOR_GAINS[1],
+        SENSOR_GAINS[2],
+        SENSOR_GAINS[3],
+        SENSOR_GAINS[4],
+        config.boundary_threshold
+    );
+    printf("calibrated thresholds:");
+    for (uint8_t i = 0; i < 5; ++i)
+    {
+        printf(" %u", calibrated5.threshold(i));
+    }
+    printf("\n\n");
+
+    printf(
+        "  %-26s %8s %8s %8s %8s %8s\n",
+        "% of labelled samples",
+        "samples",
+        "correct",
+        "missed",
+        "false",
+        "wrong dir"
+    );
+    print_score("3 sensors, shared", score(shared3, samples));
+    print_score("3 sensors, calibrated", score(calibrated3, samples));
+    print_score("5 sensors, shared", score(shared5, samples));
+    print_score("5 sensors, calibrated", score(calibrated5, samples));
+
+    printf("\n  %-26s %8s %8s\n", "per classification", "cycles", "ns");
+    unsigned int const passes = 20;
+    unsigned int const threshold = config.boundary_threshold;
+    time_classifier<3>(
+        "3 sensors, branch chain",
+        samples,
+        passes,
+        [threshold](unsigned int const * v)
+        {
+            return branch_chain(v, threshold);
+        }
+    );
+    time_classifier<3>(
+        "3 sensors, table",
+        samples,
+        passes,
+        [&calibrated3](unsigned int const * v)
+        {
+            return calibrated3.classify(v);
+        }
+    );
+    time_classifier<5>(
+        "5 sensors, table",
+        samples,
+        passes,
+        [&calibrated5](unsigned int const * v)
+        {
+            return calibrated5.classify(v);
+        }
+    );
+
+    if (argc > 2)
+    {
+        report_log(argv[2], config);
+    }
+
+    return 0;
+}
@@ -0,0 +1,257 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// Opponent chase benchmark.
+//
+// Drives an `IRobot` at an opponent in the simulated ring of arena.h, steering
+// on its proximity events, and reports how often and how fast it makes
+// contact. The robot starts parked in the centre; the opponent starts 150 to
+// 350 mm away, at a random bearing up to 110 degrees either side, crossing
+// the robot's view at 150 mm/s.
+//
+// Two steering laws are compared:
+//   - bang-bang: drive straight while the opponent is AHEAD, otherwise spin
+//     towards it (`m_direction`).
+//   - proportional: drive forward and turn in proportion to `m_bearing`.
+// Both spin towards the side the opponent was last seen on when it is lost.
+// Each runs with the front sensor only, as with five line sensors, and with
+// the side sensors as well.
+//
+// Reported per run: contacts within CHASE_LIMIT_S, mean time to contact, and
+// mean bearing of the opponent at contact (how far off centre the robot hits
+// it).
+//
+// Usage: chasebench [trials]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "arena.h"
+#include "robot.h"
+#include "sim.h"
+
+double const CHASE_LIMIT_S = 5.0;
+double const STEP_S = 0.001;
+double const CROSSING_MM_PER_S = 150.0;
+
+int16_t const DRIVE_SPEED = 300;
+int16_t const SPIN_SPEED = 200;
+int16_t const SEARCH_SPEED = 150;
+
+// Turn (difference from DRIVE_SPEED on each tread) per degree of bearing.
+int16_t const TURN_PER_DEGREE = 4;
+
+enum Steering
+{
+    BANG_BANG,
+    PROPORTIONAL
+};
+
+struct ChaseResult
+{
+    unsigned int contacts;
+    double time_s;
+    double bearing_deg;
+};
+
+// Steer on one proximity event. `last_left` remembers which side the
+// opponent was last seen on.
+static void steer(
+    IRobot & robot,
+    ProximityEvent const & e,
+    Steering steering,
+    bool & last_left
+)
+{
+    if (e.m_direction == NONE)
+    {
+        if (last_left)
+        {
+            robot.move(-SEARCH_SPEED, SEARCH_SPEED);
+        }
+        else
+        {
+            robot.move(SEARCH_SPEED, -SEARCH_SPEED);
+        }
+        return;
+    }
+
+    last_left = e.m_bearing > 0;
+    if (steering == PROPORTIONAL)
+    {
+        int16_t const turn = e.m_bearing * TURN_PER_DEGREE;
+        robot.move(DRIVE_SPEED - turn, DRIVE_SPEED + turn);
+        return;
+    }
+
+    switch (e.m_direction)
+    {
+    case LEFT:
+        robot.move(-SPIN_SPEED, SPIN_SPEED);
+        break;
+    case RIGHT:
+        robot.move(SPIN_SPEED, -SPIN_SPEED);
+        break;
+    default:
+        robot.move(DRIVE_SPEED);
+        break;
+    }
+}
+
+// One chase. Returns the time to contact, or a negative time if the robot
+// did not make contact.
+static double chase(
+    IRobot & robot,
+    sim::Arena & arena,
+    Steering steering,
+    bool sides,
+    uint32_t & seed
+)
+{
+    sim::Hardware & hw = sim::hardware();
+    bool last_left = arena.opponent.y > 0;
+    double t = 0;
+
+    sim::set_now_us(0);
+    while (t < CHASE_LIMIT_S)
+    {
+        sim::Arena::sense(arena.robot, arena.opponent, hw, seed);
+        if (!sides)
+        {
+            hw.proximity_left = 0;
+            hw.proximity_right = 0;
+        }
+        robot.generate_events();
+        while (RobotEventSlot * slot = robot.events().front())
+        {
+            if (slot->kind() == PROXIMITY_EVENT)
+            {
+                steer(
+                    robot,
+                    static_cast<ProximityEvent &>(slot->event()),
+                    steering,
+                    last_left
+                );
+            }
+            robot.events().pop();
+        }
+        robot.commit_motors();
+
+        arena.robot.motor_left = hw.motor_left;
+        arena.robot.motor_right = hw.motor_right;
+        double const now = sim::now_us() / 1e6;
+        while (t < now)
+        {
+            arena.step(STEP_S);
+            t += STEP_S;
+            if (arena.touching())
+            {
+                return t;
+            }
+            if (sim::Arena::out(arena.robot))
+            {
+                return -1;
+            }
+        }
+    }
+    return -1;
+}
+
+static ChaseResult run(
+    IRobot & robot,
+    Steering steering,
+    bool sides,
+    unsigned int trials
+)
+{
+    ChaseResult r = {0, 0.0, 0.0};
+    uint32_t seed = 1;
+    int16_t const crossing = static_cast<int16_t>(
+        CROSSING_MM_PER_S / sim::MM_PER_S_PER_SPEED
+    );
+
+    for (unsigned int i = 0; i < trials; ++i)
+    {
+        sim::Hardware & hw = sim::hardware();
+        hw = sim::Hardware();
+        sim::set_now_us(0);
+        robot.setup();
+        robot.set_event_policy(PROXIMITY_EVENT, LEVEL);
+        while (robot.events().front())
+        {
+            robot.events().pop();
+        }
+
+        // Opponent at bearing `b`, crossing clockwise or anticlockwise.
+        double const b = sim::uniform(seed, -110, 110) * M_PI / 180;
+        double const range =
+            sim::BODY_RADIUS_MM * 2 + sim::uniform(seed, 150, 350);
+        double const across = (sim::next(seed) & 1) ? M_PI / 2 : -M_PI / 2;
+        sim::Arena arena;
+        arena.robot = sim::Body{0, 0, 0, 0, 0};
+        arena.opponent = sim::Body{
+            range * cos(b),
+            range * sin(b),
+            b + across,
+            crossing,
+            crossing
+        };
+
+        double const s = chase(robot, arena, steering, sides, seed);
+        if (s >= 0)
+        {
+            ++r.contacts;
+            r.time_s += s;
+            r.bearing_deg +=
+                fabs(sim::Arena::bearing(arena.robot, arena.opponent)) *
+                180 / M_PI;
+        }
+    }
+
+    if (r.contacts)
+    {
+        r.time_s /= r.contacts;
+        r.bearing_deg /= r.contacts;
+    }
+    return r;
+}
+
+int main(int argc, char ** argv)
+{
+    unsigned int const trials =
+        argc > 1 ? strtoul(argv[1], nullptr, 0) : 1000;
+    IRobot robot;
+
+    printf(
+        "%u chases per run, %.0f s limit, opponent crossing at %.0f mm/s\n",
+        trials,
+        CHASE_LIMIT_S,
+        CROSSING_MM_PER_S
+    );
+    printf("steering      sensors        contacts  time to contact  "
+        "bearing at contact\n");
+
+    Steering const steerings[] = {BANG_BANG, PROPORTIONAL};
+    char const * const steering_names[] = {"bang-bang", "proportional"};
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        for (unsigned int sides = 0; sides < 2; ++sides)
+        {
+            ChaseResult const r = run(robot, steerings[i], sides, trials);
+            printf(
+                "%-13s %-14s %7.1f%%  %11.0f ms  %14.1f deg\n",
+                steering_names[i],
+                sides ? "front and side" : "front",
+                100.0 * r.contacts / trials,
+                1000 * r.time_s,
+                r.bearing_deg
+            );
+        }
+    }
+
+    return 0;
+}
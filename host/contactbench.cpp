@@ -0,0 +1,474 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// Contact detection benchmark.
+//
+// Replays an IMU log (see imulog.h) through the simulated LSM303D and an
+// `IRobot`, which empties the accelerometer FIFO in bursts and raises
+// `ContactEvent`s, and scores the events against the log's contact labels:
+// for collisions and pushes, how many were detected, the latency from the
+// labelled start to dispatch, and how often the side was right, plus
+// detections with no label per minute. The log's motor commands are issued
+// as the replay reaches them, so the robot knows when its own motion has
+// settled.
+//
+// Also reports the cost per sample: modelled I2C transfer time for the
+// burst reads, against a `readAcc()` per sample, and host cycles per
+// `ContactDetector::update()`.
+//
+// Without a log, generates one and replays it. The generated robot drives
+// forwards and backwards with traction-limited starts and stops, tread
+// vibration and the odd single-sample knock. Every few seconds, at least
+// 300 ms after its last change of speed, it is hit from a random side:
+// collisions (2 to 5 g), half of them followed by a push, and pushes alone
+// (0.35 to 0.7 g for 0.4 to 1.5 s).
+//
+// Usage:
+//   contactbench [secs]                     generate a log and replay it
+//   contactbench generate FILE secs [seed]  write a generated log
+//   contactbench FILE                       replay a log
+
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "arena.h"
+#include "contactdetector.h"
+#include "imulog.h"
+#include "robot.h"
+#include "sim.h"
+
+typedef std::chrono::steady_clock Clock;
+
+double const COUNTS_PER_G = 4096.0;
+double const MM_PER_S2_PER_G = 9810.0;
+uint16_t const SAMPLE_PERIOD_US = 2500;
+
+// Generated robot: speed lag and traction limit, and sensor bias and noise.
+double const DRIVE_TIME_CONSTANT_S = 0.1;
+double const TRACTION_G = 0.5;
+double const BIAS_G[3] = {0.015, -0.01, 1.0};
+double const NOISE_G = 0.02;
+double const VIBRATION_G = 0.05;
+double const SETTLE_S = 0.3;
+
+// Longest delay from a labelled contact to its event.
+double const COLLISION_WINDOW_S = 0.1;
+double const PUSH_WINDOW_S = 0.5;
+
+static char const * const type_names[] = {"collision", "push"};
+
+struct Label
+{
+    double t_s;
+    ContactType type;
+    ContactSide side;
+    bool matched;
+};
+
+struct Score
+{
+    unsigned int labelled;
+    unsigned int detected;
+    unsigned int side_right;
+    double latency_s;
+    double max_latency_s;
+};
+
+static uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static int16_t counts(double g)
+{
+    double const c = round(g * COUNTS_PER_G);
+    return c > 32767 ? 32767 : c < -32768 ? -32768 : static_cast<int16_t>(c);
+}
+
+static std::vector<sim::ImuLogRecord> generate(double seconds, uint32_t seed)
+{
+    int16_t const commands[] = {-300, -150, 0, 150, 300, 400};
+    // Acceleration direction for a contact on each side (`ContactSide`).
+    double const directions[4][2] = {{-1, 0}, {0, -1}, {0, 1}, {1, 0}};
+    double const dt = SAMPLE_PERIOD_US / 1e6;
+    std::vector<sim::ImuLogRecord> log(
+        static_cast<size_t>(seconds / dt)
+    );
+
+    double speed = 0;
+    int16_t motor = 0;
+    double next_command = 1.0;
+    double next_contact = 2.0;
+
+    // Contact in progress: start, end, side, perpendicular share, impact
+    // peak, and push level, start and length.
+    bool contact = false;
+    double start = 0;
+    double end = 0;
+    unsigned int side = 0;
+    double skew = 0;
+    double impact = 0;
+    double push = 0;
+    double push_start = 0;
+    double push_length = 0;
+    bool push_labelled = false;
+
+    for (size_t i = 0; i < log.size(); ++i)
+    {
+        double const t = i * dt;
+        sim::ImuLogRecord & r = log[i];
+        memset(&r, 0, sizeof(r));
+        double a[2] = {0, 0};
+
+        // Own motion, never changing during a contact.
+        if (!contact && t >= next_command)
+        {
+            motor = commands[sim::next(seed) % 6];
+            next_command = t + sim::uniform(seed, 0.5, 2.5);
+            if (next_contact < t + SETTLE_S)
+            {
+                next_contact = t + SETTLE_S;
+            }
+        }
+        double const target = motor * sim::MM_PER_S_PER_SPEED;
+        double drive = (target - speed) / DRIVE_TIME_CONSTANT_S;
+        double const limit = TRACTION_G * MM_PER_S2_PER_G;
+        drive = drive > limit ? limit : drive < -limit ? -limit : drive;
+        speed += drive * dt;
+        a[0] += drive / MM_PER_S2_PER_G;
+        if (fabs(speed) > 50)
+        {
+            a[0] += sim::uniform(seed, -VIBRATION_G, VIBRATION_G);
+            a[1] += sim::uniform(seed, -VIBRATION_G, VIBRATION_G);
+        }
+        if (sim::next(seed) % 800 == 0)
+        {
+            a[sim::next(seed) % 2] += (sim::next(seed) % 2 ? 1 : -1) *
+                sim::uniform(seed, 0.3, 0.8);
+        }
+
+        // Contacts.
+        if (!contact && t >= next_contact)
+        {
+            unsigned int const kind = sim::next(seed) % 10;
+            contact = true;
+            start = t;
+            side = sim::next(seed) % 4;
+            skew = sim::uniform(seed, -0.3, 0.3);
+            impact = kind < 7 ? sim::uniform(seed, 2.0, 5.0) : 0;
+            push = kind >= 4 ? sim::uniform(seed, 0.35, 0.7) : 0;
+            push_start = impact ? t + 0.02 : t;
+            push_length = sim::uniform(seed, 0.4, 1.5);
+            push_labelled = false;
+            end = push ? push_start + push_length + 0.1 : t + 0.05;
+            if (impact)
+            {
+                r.contact = sim::IMU_LOG_CONTACT | COLLISION << 2 | side;
+            }
+        }
+        if (contact)
+        {
+            double level = 0;
+            if (impact)
+            {
+                double const x = (t - start) / 0.0025;
+                level += impact * x * exp(1 - x);
+            }
+            if (push && t >= push_start)
+            {
+                if (!push_labelled)
+                {
+                    r.contact = sim::IMU_LOG_CONTACT | PUSHED << 2 | side;
+                    push_labelled = true;
+                }
+                double const rise = (t - push_start) / 0.06;
+                double const fall = (push_start + push_length + 0.1 - t) / 0.1;
+                double const ramp = rise < 1 ? rise : fall < 1 ? fall : 1;
+                level += push * (ramp > 0 ? ramp : 0);
+            }
+            double const * d = directions[side];
+            a[0] += level * (d[0] - skew * d[1]);
+            a[1] += level * (d[1] + skew * d[0]);
+            if (t >= end)
+            {
+                contact = false;
+                next_contact = t + sim::uniform(seed, 2.0, 5.0);
+            }
+        }
+
+        for (unsigned int axis = 0; axis < 3; ++axis)
+        {
+            double const noise = NOISE_G * (sim::uniform(seed, -1, 1) +
+                sim::uniform(seed, -1, 1) + sim::uniform(seed, -1, 1));
+            r.accel[axis] =
+                counts(BIAS_G[axis] + (axis < 2 ? a[axis] : 0) + noise);
+        }
+        r.motor = motor;
+    }
+
+    return log;
+}
+
+// Replay `log` through a robot, and score its contact events.
+static void replay(
+    std::vector<sim::ImuLogRecord> const & log,
+    uint16_t period_us
+)
+{
+    std::vector<Label> labels;
+    for (size_t i = 0; i < log.size(); ++i)
+    {
+        uint8_t const c = log[i].contact;
+        if (c & sim::IMU_LOG_CONTACT)
+        {
+            Label const label = {
+                i * period_us / 1e6,
+                static_cast<ContactType>((c >> 2) & 1),
+                static_cast<ContactSide>(c & 3),
+                false
+            };
+            labels.push_back(label);
+        }
+    }
+
+    sim::Hardware & hw = sim::hardware();
+    hw = sim::Hardware();
+    sim::set_now_us(0);
+    hw.accelerometer.source = [&log, period_us](
+        unsigned long t_us,
+        int16_t * xyz
+    )
+    {
+        size_t const i = t_us / period_us;
+        if (i < log.size())
+        {
+            memcpy(xyz, log[i].accel, sizeof(log[i].accel));
+        }
+    };
+
+    IRobot robot;
+    robot.setup();
+    while (robot.events().front())
+    {
+        robot.events().pop();
+    }
+
+    Score scores[2];
+    memset(scores, 0, sizeof(scores));
+    unsigned int false_detections = 0;
+    int16_t motor = 0;
+    unsigned long const end_us =
+        static_cast<unsigned long>(log.size()) * period_us;
+
+    while (sim::now_us() < end_us)
+    {
+        sim::ImuLogRecord const & r = log[sim::now_us() / period_us];
+        if (r.motor != motor)
+        {
+            motor = r.motor;
+            robot.move(motor);
+        }
+
+        robot.generate_events();
+        while (RobotEventSlot * slot = robot.events().front())
+        {
+            if (slot->kind() != CONTACT_EVENT)
+            {
+                robot.events().pop();
+                continue;
+            }
+
+            ContactEvent const & e =
+                static_cast<ContactEvent &>(slot->event());
+            double const t = sim::now_us() / 1e6;
+            double const window =
+                e.m_type == COLLISION ? COLLISION_WINDOW_S : PUSH_WINDOW_S;
+            Label * match = nullptr;
+            for (Label & label : labels)
+            {
+                if (
+                    !label.matched &&
+                    label.type == e.m_type &&
+                    label.t_s <= t &&
+                    t - label.t_s <= window
+                )
+                {
+                    match = &label;
+                    break;
+                }
+            }
+            if (match)
+            {
+                Score & s = scores[e.m_type];
+                double const latency = t - match->t_s;
+                match->matched = true;
+                ++s.detected;
+                s.side_right += e.m_side == match->side;
+                s.latency_s += latency;
+                if (latency > s.max_latency_s)
+                {
+                    s.max_latency_s = latency;
+                }
+            }
+            else
+            {
+                ++false_detections;
+            }
+            robot.events().pop();
+        }
+        robot.commit_motors();
+    }
+
+    for (Label const & label : labels)
+    {
+        ++scores[label.type].labelled;
+    }
+
+    double const seconds = end_us / 1e6;
+    printf(
+        "%.0f s log, %.0f samples/s, %u collisions and %u pushes labelled\n",
+        seconds,
+        1e6 / period_us,
+        scores[COLLISION].labelled,
+        scores[PUSHED].labelled
+    );
+    printf(
+        "  %-10s %8s %8s %14s %10s %10s\n",
+        "contact",
+        "labelled",
+        "detected",
+        "mean latency",
+        "max",
+        "side right"
+    );
+    for (unsigned int type = 0; type < 2; ++type)
+    {
+        Score const & s = scores[type];
+        unsigned int const detected = s.detected ? s.detected : 1;
+        printf(
+            "  %-10s %8u %7.1f%% %11.1f ms %7.1f ms %9.1f%%\n",
+            type_names[type],
+            s.labelled,
+            s.labelled ? 100.0 * s.detected / s.labelled : 0.0,
+            1000 * s.latency_s / detected,
+            1000 * s.max_latency_s,
+            100.0 * s.side_right / detected
+        );
+    }
+    printf(
+        "  unlabelled detections: %u (%.2f per minute)\n",
+        false_detections,
+        false_detections * 60 / seconds
+    );
+
+    // Modelled I2C time per sample, burst reads against one read per sample.
+    SensorScheduler const & sensors = robot.sensor_schedule();
+    ImuFifo const & fifo = robot.accelerometer();
+    double const reads = sensors.samples(ACCELEROMETER_SENSOR);
+    double const burst_us = sensors.mean_read_us(ACCELEROMETER_SENSOR) *
+        reads / fifo.samples();
+    LSM303 accelerometer;
+    unsigned long const before_us = sim::now_us();
+    accelerometer.readAcc();
+    unsigned long const single_us = sim::now_us() - before_us;
+    printf(
+        "I2C per sample (400 kHz): %.0f us in bursts of %.1f, %lu us by "
+        "readAcc()\n",
+        burst_us,
+        fifo.samples() / reads,
+        single_us
+    );
+    printf(
+        "FIFO: %lu samples read, %lu overruns\n",
+        fifo.samples(),
+        fifo.overruns()
+    );
+}
+
+// Host cost of `ContactDetector::update()` over the samples of `log`.
+static void time_detector(std::vector<sim::ImuLogRecord> const & log)
+{
+    RobotConfig const config;
+    ContactDetector detector;
+    detector.configure(config.collision_threshold, config.push_threshold);
+    unsigned int const passes = 20;
+    unsigned long found = 0;
+
+    Clock::time_point const start = Clock::now();
+    uint64_t const start_cycles = cycles();
+    for (unsigned int pass = 0; pass < passes; ++pass)
+    {
+        for (sim::ImuLogRecord const & r : log)
+        {
+            found += detector.update(r.accel[0], r.accel[1], true);
+        }
+    }
+    uint64_t const elapsed_cycles = cycles() - start_cycles;
+    double const seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    double const n = static_cast<double>(log.size()) * passes;
+
+    printf(
+        "detector (host): %.1f cycles, %.2f ns per sample (%lu detections)\n",
+        elapsed_cycles / n,
+        seconds * 1e9 / n,
+        found
+    );
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc >= 4 && strcmp(argv[1], "generate") == 0)
+    {
+        uint32_t const seed = argc > 4 ? strtoul(argv[4], nullptr, 0) : 1;
+        std::vector<sim::ImuLogRecord> const log =
+            generate(strtod(argv[3], nullptr), seed);
+        if (
+            !sim::write_imu_log(
+                argv[2],
+                sim::imu_log_header(SAMPLE_PERIOD_US),
+                log
+            )
+        )
+        {
+            return 1;
+        }
+        printf("%s: %lu records\n", argv[2], (unsigned long)log.size());
+        return 0;
+    }
+
+    std::vector<sim::ImuLogRecord> log;
+    uint16_t period_us = SAMPLE_PERIOD_US;
+    if (argc > 1 && atof(argv[1]) == 0)
+    {
+        sim::ImuLogHeader header;
+        if (!sim::read_imu_log(argv[1], header, log))
+        {
+            return 1;
+        }
+        period_us = header.sample_period_us;
+    }
+    else
+    {
+        log = generate(argc > 1 ? atof(argv[1]) : 600, 1);
+    }
+
+    replay(log, period_us);
+    time_detector(log);
+
+    return 0;
+}
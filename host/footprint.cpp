@@ -0,0 +1,140 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// State machine footprint report.
+//
+// Lists the bytes each state and event of the robot's state machine takes,
+// how much of that is the state machine library's, and where their names
+// are kept: in RAM, or in program memory with STATEMACHINE_COMPACT. The
+// Makefile builds it as is and with STATEMACHINE_COMPACT, and writes both
+// reports to build/footprint.txt on every build.
+//
+// Sizes are the host's, where pointers are 8 bytes and `int` is 4; on the
+// ATmega32U4 both are 2, so compare the two builds rather than reading the
+// numbers as the robot's.
+//
+// Usage: footprint
+
+#include <stdio.h>
+#include <string.h>
+#include "robotstatemachine.h"
+
+// Name of a state or event, copied out of program memory if need be.
+struct Name
+{
+    explicit Name(char const * name)
+    {
+        statemachine::read_name(name, text, sizeof(text));
+    }
+
+    char text[16];
+};
+
+struct EventSize
+{
+    Event const & event;
+    size_t bytes;
+};
+
+int main()
+{
+#ifdef STATEMACHINE_COMPACT
+    char const * const build = "compact";
+    char const * const names_in = "flash";
+    bool const names_in_ram = false;
+#else
+    char const * const build = "normal";
+    char const * const names_in = "RAM";
+    bool const names_in_ram = true;
+#endif
+
+    IRobot robot;
+    RobotStateMachine machine(robot);
+
+    // Bytes of each state's own, with the machine's states (its members)
+    // taken out of its size.
+    size_t const state_bytes[] = {
+        sizeof(RobotStateMachine) - sizeof(InitState) - sizeof(StandbyState),
+        sizeof(InitState),
+        sizeof(StandbyState)
+    };
+    size_t const state_count = sizeof(state_bytes) / sizeof(state_bytes[0]);
+
+    printf(
+        "State machine footprint, %s build (host bytes, names in %s)\n",
+        build,
+        names_in
+    );
+    printf("%-10s %6s %8s %6s\n", "state", "bytes", "library", "name");
+    size_t states_total = 0;
+    size_t names_total = 0;
+    for (uint8_t i = 0; i < state_count; ++i)
+    {
+        State * state = machine.state_at(i);
+        if (!state)
+        {
+            printf("state %u is not in the frozen table\n", i);
+            return 1;
+        }
+        Name const name(state->name());
+        size_t const name_bytes = strlen(name.text) + 1;
+        printf(
+            "%-10s %6zu %8zu %6zu\n",
+            name.text,
+            state_bytes[i],
+            sizeof(State),
+            name_bytes
+        );
+        states_total += state_bytes[i];
+        names_total += name_bytes;
+    }
+
+    StartButtonEvent const start;
+    TimerEvent const timer;
+    BoundaryEvent const boundary;
+    ContactEvent const contact;
+    EncoderEvent const encoder;
+    ProximityEvent const proximity;
+    EventSize const events[] = {
+        {start, sizeof(start)},
+        {timer, sizeof(timer)},
+        {boundary, sizeof(boundary)},
+        {contact, sizeof(contact)},
+        {encoder, sizeof(encoder)},
+        {proximity, sizeof(proximity)}
+    };
+
+    printf("\n%-10s %6s %8s %6s\n", "event", "bytes", "library", "name");
+    for (EventSize const & e : events)
+    {
+        Name const name(e.event.m_name);
+        size_t const name_bytes = strlen(name.text) + 1;
+        printf(
+            "%-10s %6zu %8zu %6zu\n",
+            name.text,
+            e.bytes,
+            sizeof(Event),
+            name_bytes
+        );
+        names_total += name_bytes;
+    }
+
+    size_t const queue_bytes = sizeof(EventQueue);
+    printf(
+        "\nqueue slot %zu bytes, queue %zu bytes\n",
+        sizeof(RobotEventSlot),
+        queue_bytes
+    );
+    printf(
+        "RAM: states %zu + queue %zu + names %zu = %zu bytes\n",
+        states_total,
+        queue_bytes,
+        names_in_ram ? names_total : 0,
+        states_total + queue_bytes + (names_in_ram ? names_total : 0)
+    );
+    printf("flash: names %zu bytes\n", names_in_ram ? 0 : names_total);
+}
@@ -0,0 +1,94 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "imulog.h"
+
+namespace sim
+{
+    ImuLogHeader imu_log_header(uint16_t sample_period_us)
+    {
+        ImuLogHeader header =
+        {
+            {'S', 'B', 'I', 'L'},
+            IMU_LOG_VERSION,
+            sizeof(ImuLogRecord),
+            sample_period_us
+        };
+        return header;
+    }
+
+    bool read_imu_log(
+        char const * path,
+        ImuLogHeader & header,
+        std::vector<ImuLogRecord> & records
+    )
+    {
+        FILE * f = fopen(path, "rb");
+        if (!f)
+        {
+            perror(path);
+            return false;
+        }
+
+        ImuLogHeader const expected = imu_log_header(0);
+        if (
+            fread(&header, sizeof(header), 1, f) != 1 ||
+            memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+            header.version != expected.version ||
+            header.record_size != expected.record_size ||
+            header.sample_period_us == 0
+        )
+        {
+            fprintf(
+                stderr,
+                "%s: not a version %u IMU log\n",
+                path,
+                IMU_LOG_VERSION
+            );
+            fclose(f);
+            return false;
+        }
+
+        records.clear();
+        ImuLogRecord record;
+        while (fread(&record, sizeof(record), 1, f) == 1)
+        {
+            records.push_back(record);
+        }
+        fclose(f);
+        return true;
+    }
+
+    bool write_imu_log(
+        char const * path,
+        ImuLogHeader const & header,
+        std::vector<ImuLogRecord> const & records
+    )
+    {
+        FILE * f = fopen(path, "wb");
+        if (!f)
+        {
+            perror(path);
+            return false;
+        }
+
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+            fwrite(
+                records.data(),
+                sizeof(ImuLogRecord),
+                records.size(),
+                f
+            ) == records.size();
+        ok = fclose(f) == 0 && ok;
+        if (!ok)
+        {
+            perror(path);
+        }
+        return ok;
+    }
+}
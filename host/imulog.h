@@ -0,0 +1,62 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Recorded accelerometer samples, for replay through the simulated LSM303D.
+//
+// An IMU log is an `ImuLogHeader` followed by one `ImuLogRecord` per
+// accelerometer sample, at a fixed sample period. Multi-byte fields are
+// little-endian, as written by the robot.
+namespace sim
+{
+    struct ImuLogHeader
+    {
+        char magic[4];
+        uint8_t version;
+        uint8_t record_size;
+        uint16_t sample_period_us;
+    };
+
+    struct ImuLogRecord
+    {
+        // Accelerometer reading: x forward, y left, z up, in raw counts at
+        // +/-8 g full scale.
+        int16_t accel[3];
+
+        // Motor command in effect (both treads).
+        int16_t motor;
+
+        // 0, or a contact starting at this sample, marked by hand or by a
+        // generator: IMU_LOG_CONTACT | `ContactType` << 2 | `ContactSide`.
+        uint8_t contact;
+        uint8_t reserved;
+    };
+
+    static_assert(sizeof(ImuLogRecord) == 10, "Records must be 10 bytes.");
+
+    uint8_t const IMU_LOG_VERSION = 1;
+    uint8_t const IMU_LOG_CONTACT = 0x80;
+
+    // Header for a new log.
+    ImuLogHeader imu_log_header(uint16_t sample_period_us);
+
+    // Read or write the log at `path`. Print the reason and return `false` on
+    // failure.
+    bool read_imu_log(
+        char const * path,
+        ImuLogHeader & header,
+        std::vector<ImuLogRecord> & records
+    );
+    bool write_imu_log(
+        char const * path,
+        ImuLogHeader const & header,
+        std::vector<ImuLogRecord> const & records
+    );
+}
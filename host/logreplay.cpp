@@ -0,0 +1,210 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// Sensor log replay.
+//
+// Replays recorded sensor logs (see sensorlog.h) through a pass of the
+// sketch's `loop()`, sensor reads, event generation and dispatch included, one
+// pass per record and as fast as the host allows, and reports the events
+// dispatched and transitions taken for each log. Each log gets its own
+// `IRobot` and state machine, started as the sketch's `setup()` does, so logs
+// do not carry state into each other. The sketch is built with TRACING, and
+// its trace is read after each pass to count them.
+//
+// Logs are memory mapped, so multi-hour logs replay without being loaded.
+//
+// Usage:
+//   logreplay FILE...                      replay each log
+//   logreplay generate FILE secs [seed]    write a synthetic log
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eventqueue.h"
+#include "robot.h"
+#include "robotstatemachine.h"
+#include "sensorlog.h"
+#include "sim.h"
+#include "trace.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static uint32_t seed = 1;
+
+// Synthetic log: the tools' noisy scenario (see `sim::step_noisy()`), with
+// slow wheel motion, at about one record per 2.2 ms.
+static int generate(char const * path, unsigned long seconds)
+{
+    FILE * f = fopen(path, "wb");
+    if (!f)
+    {
+        perror(path);
+        return 1;
+    }
+
+    sim::SensorLogHeader const header = sim::sensor_log_header();
+    fwrite(&header, sizeof(header), 1, f);
+
+    sim::Hardware hw;
+    unsigned long records = 0;
+    uint64_t const end_us = seconds * 1000000ULL;
+    for (uint64_t t = 0; t < end_us; t += 2000 + sim::next(seed) % 400)
+    {
+        sim::step_noisy(hw, records, seed);
+
+        sim::SensorLogRecord r;
+        memset(&r, 0, sizeof(r));
+        r.time_us = static_cast<uint32_t>(t);
+        r.buttons = hw.start_button;
+        for (unsigned int i = 0; i < 5; ++i)
+        {
+            r.line[i] = hw.line[i];
+        }
+        r.proximity_front_left = hw.proximity_front_left;
+        r.proximity_front_right = hw.proximity_front_right;
+        r.encoder_left = sim::next(seed) % 5;
+        r.encoder_right = sim::next(seed) % 5;
+
+        fwrite(&r, sizeof(r), 1, f);
+        ++records;
+    }
+    fclose(f);
+
+    printf("%s: %lu records, %lu s\n", path, records, seconds);
+    return 0;
+}
+
+static int replay(char const * path)
+{
+    sim::SensorLog log;
+    if (!log.open(path))
+    {
+        return 1;
+    }
+    if (!log.size())
+    {
+        printf("%s: empty\n", path);
+        return 0;
+    }
+
+    // Start each log from power up, with a new robot and machine.
+    sim::Hardware & hw = sim::hardware();
+    hw = sim::Hardware();
+    hw.counts_per_speed_s = 0;
+    sim::set_now_us(log[0].time_us);
+    IRobot robot;
+    RobotStateMachine machine(robot);
+    robot.setup();
+    robot.set_event_policy(BOUNDARY_EVENT, EDGE);
+    robot.set_event_policy(PROXIMITY_EVENT, EDGE);
+    machine.transition_to_state(machine);
+    trace.reset();
+    unsigned long events[TIMER_EVENT + 1] = {0};
+    unsigned long transitions = 0;
+    uint32_t written = 0;
+
+    Clock::time_point const start = Clock::now();
+    for (size_t i = 0; i < log.size(); ++i)
+    {
+        sim::apply(log[i], hw);
+
+        // As the sketch's `loop()`.
+        robot.generate_events();
+        EventQueue & queue = robot.events();
+        while (RobotEventSlot * slot = queue.front())
+        {
+            TRACE_EVENT(*slot);
+            machine.handle_event(slot->event());
+            queue.pop();
+        }
+        robot.commit_motors();
+        robot.update_display();
+
+        // Count what the pass recorded.
+        uint32_t const now_written = trace.dropped() + trace.size();
+        for (uint16_t j = trace.size() - (now_written - written);
+            j < trace.size();
+            ++j)
+        {
+            uint8_t const type = trace.record(j).type;
+            if (type == TRACE_TRANSITION_RECORD)
+            {
+                ++transitions;
+            }
+            else if (type <= TIMER_EVENT)
+            {
+                ++events[type];
+            }
+        }
+        written = now_written;
+    }
+    double const seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    double const logged_seconds = static_cast<uint32_t>(
+        log[log.size() - 1].time_us - log[0].time_us
+    ) / 1e6;
+
+    RobotEventSlot const kinds[] = {
+        BoundaryEvent(),
+        ContactEvent(),
+        EncoderEvent(),
+        ProximityEvent(),
+        StartButtonEvent(),
+        TimerEvent()
+    };
+    printf(
+        "%s: %lu records, %.1f s logged, replayed in %.2f s (%.0fx real time)\n",
+        path,
+        static_cast<unsigned long>(log.size()),
+        logged_seconds,
+        seconds,
+        logged_seconds / seconds
+    );
+    printf("  events dispatched:");
+    for (RobotEventSlot slot : kinds)
+    {
+        printf(" %s %lu", slot.event().m_name, events[slot.kind()]);
+    }
+    printf("\n");
+    printf(
+        "  %lu suppressed by event policy, %lu coalesced, %lu transitions\n",
+        robot.suppressed_events(),
+        robot.events().coalesced(),
+        transitions
+    );
+
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc >= 4 && strcmp(argv[1], "generate") == 0)
+    {
+        if (argc > 4)
+        {
+            seed = strtoul(argv[4], nullptr, 0);
+        }
+        return generate(argv[2], strtoul(argv[3], nullptr, 0));
+    }
+    if (argc < 2)
+    {
+        fprintf(
+            stderr,
+            "usage: logreplay FILE...\n"
+            "       logreplay generate FILE seconds [seed]\n"
+        );
+        return 1;
+    }
+
+    int status = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        status |= replay(argv[i]);
+    }
+    return status;
+}
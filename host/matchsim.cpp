@@ -0,0 +1,417 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// Monte-Carlo sumo match simulator.
+//
+// Runs the sketch's state machine, through its `IRobot`, in the simulated
+// ring of arena.h against scripted opponents, from random starting poses,
+// and reports wins, losses and draws against each opponent, how the losing
+// robot left the ring, and matches per second.
+//
+// A match starts with a start button press. Both robots wait five seconds,
+// as the rules require (`StandbyState` does this for the sketch). A robot
+// loses when its centre leaves the ring: pushed out if the robots touched in
+// the last half second, else driven out. A match is drawn after the time
+// limit.
+//
+// Each match owns its `Hardware`, `IRobot` and state machine, so many run in
+// one process. Each worker thread plays its share of matches against an
+// opponent as one batch, a contiguous array of matches. Results do not depend on the number of workers: each
+// match is seeded by its index.
+//
+// Usage: matchsim [matches per opponent] [workers]
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "arena.h"
+#include "sim.h"
+#include "../robot.h"
+#include "../robotstatemachine.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// Scripted opponents.
+enum Opponent
+{
+    // Never moves.
+    IDLE_OPPONENT,
+    // Turns toward the robot and drives at it at full speed.
+    CHARGE_OPPONENT,
+    // Drives around, turning back from the border, and charges when it sees
+    // the robot ahead.
+    WANDER_OPPONENT,
+    OPPONENT_COUNT
+};
+
+static char const * const opponent_names[OPPONENT_COUNT] =
+{
+    "idle",
+    "charge",
+    "wander"
+};
+
+struct Results
+{
+    unsigned long matches;
+    unsigned long wins;
+    unsigned long losses;
+    unsigned long draws;
+    // How the losing robot left the ring.
+    unsigned long robot_pushed_out;
+    unsigned long robot_drove_out;
+    unsigned long opponent_pushed_out;
+    unsigned long opponent_drove_out;
+    // Time from the end of the start delay to a decision.
+    double decision_s;
+};
+
+double const START_DELAY_S = 5.0;
+double const MATCH_S = 30.0;
+double const STEP_S = 0.001;
+
+static int16_t clip(double speed)
+{
+    return static_cast<int16_t>(speed > 400 ? 400 : speed < -400 ? -400 : speed);
+}
+
+// Steer toward the robot at full speed.
+static void charge(sim::Body & self, sim::Body const & robot)
+{
+    double const b = sim::Arena::bearing(self, robot);
+    self.motor_left = clip(400 - 600 * b);
+    self.motor_right = clip(400 + 600 * b);
+}
+
+// Set the opponent's motors for the next step.
+static void drive_opponent(
+    Opponent opponent,
+    sim::Arena & arena,
+    double & turn_s,
+    double t
+)
+{
+    sim::Body & self = arena.opponent;
+
+    switch (opponent)
+    {
+    case CHARGE_OPPONENT:
+        charge(self, arena.robot);
+        break;
+    case WANDER_OPPONENT:
+    {
+        double const fx = self.x + sim::BODY_RADIUS_MM * cos(self.heading);
+        double const fy = self.y + sim::BODY_RADIUS_MM * sin(self.heading);
+        bool const border = hypot(fx, fy) >
+            sim::RING_RADIUS_MM - sim::BORDER_MM;
+        bool const sees = sim::Arena::gap(self, arena.robot) <
+            sim::PROXIMITY_RANGE_MM &&
+            fabs(sim::Arena::bearing(self, arena.robot)) <
+            sim::PROXIMITY_HALF_ANGLE;
+
+        if (border && t >= turn_s)
+        {
+            // Back off and turn for a moment.
+            turn_s = t + 0.4;
+        }
+        if (t < turn_s)
+        {
+            self.motor_left = -300;
+            self.motor_right = 100;
+        }
+        else if (sees)
+        {
+            charge(self, arena.robot);
+        }
+        else
+        {
+            self.motor_left = 250;
+            self.motor_right = 200;
+        }
+        break;
+    }
+    default:
+        self.motor_left = self.motor_right = 0;
+        break;
+    }
+}
+
+// One match in a batch: the robot under test, its ring and opponent, and
+// the match clock.
+struct Match
+{
+    Match() :
+        machine(robot)
+    {}
+
+    sim::Hardware hw;
+    IRobot robot;
+    RobotStateMachine machine;
+    sim::Arena arena;
+    Opponent opponent;
+    uint32_t seed;
+    double press_s;
+    double start_s;
+    double end_s;
+    double last_touch_s;
+    double turn_s;
+    double t;
+    bool robot_out;
+    bool opponent_out;
+};
+
+// Set up the robot as the sketch's `setup()` does, and place both robots:
+// either side of the centre, facing anywhere.
+static void start_match(Match & m, Opponent opponent, uint32_t seed)
+{
+    sim::select(m.hw);
+    m.robot.setup();
+    m.robot.set_event_policy(BOUNDARY_EVENT, EDGE);
+    m.robot.set_event_policy(PROXIMITY_EVENT, EDGE);
+    m.machine.transition_to_state(m.machine);
+
+    double const angle = sim::uniform(seed, -M_PI, M_PI);
+    double const distance = sim::uniform(seed, 100, 200);
+    m.arena.robot = sim::Body{
+        distance * cos(angle),
+        distance * sin(angle),
+        sim::uniform(seed, -M_PI, M_PI),
+        0,
+        0
+    };
+    m.arena.opponent = sim::Body{
+        -distance * cos(angle),
+        -distance * sin(angle),
+        sim::uniform(seed, -M_PI, M_PI),
+        0,
+        0
+    };
+
+    m.opponent = opponent;
+    m.press_s = sim::uniform(seed, 0.1, 0.2);
+    m.start_s = m.press_s + START_DELAY_S;
+    m.end_s = m.start_s + MATCH_S;
+    m.last_touch_s = -1.0;
+    m.turn_s = 0.0;
+    m.t = sim::now_us() / 1e6;
+    m.robot_out = false;
+    m.opponent_out = false;
+    m.seed = seed;
+}
+
+static bool finished(Match const & m)
+{
+    return m.t >= m.end_s || m.robot_out || m.opponent_out;
+}
+
+// Run one pass of the sketch's `loop()`, then move both robots up to the time
+// it took.
+static void step_match(Match & m)
+{
+    sim::Hardware & hw = m.hw;
+    sim::select(hw);
+
+    sim::Arena::sense(m.arena.robot, m.arena.opponent, hw, m.seed);
+    hw.start_button = m.t >= m.press_s && m.t < m.press_s + 0.05;
+
+    m.robot.generate_events();
+    EventQueue & events = m.robot.events();
+    while (RobotEventSlot * slot = events.front())
+    {
+        m.machine.handle_event(slot->event());
+        events.pop();
+    }
+    m.robot.commit_motors();
+    m.robot.update_display();
+
+    double const now = sim::now_us() / 1e6;
+    m.arena.robot.motor_left = hw.motor_left;
+    m.arena.robot.motor_right = hw.motor_right;
+    while (m.t < now && !m.robot_out && !m.opponent_out)
+    {
+        if (m.t >= m.start_s)
+        {
+            drive_opponent(m.opponent, m.arena, m.turn_s, m.t);
+        }
+        m.arena.step(STEP_S);
+        m.t += STEP_S;
+        if (m.arena.touching())
+        {
+            m.last_touch_s = m.t;
+        }
+        m.robot_out = sim::Arena::out(m.arena.robot);
+        m.opponent_out = sim::Arena::out(m.arena.opponent);
+    }
+}
+
+static void score_match(Match const & m, Results & results)
+{
+    bool const pushed = m.t - m.last_touch_s < 0.5;
+    ++results.matches;
+    if (m.robot_out && m.opponent_out)
+    {
+        ++results.draws;
+    }
+    else if (m.robot_out)
+    {
+        ++results.losses;
+        ++(pushed ? results.robot_pushed_out : results.robot_drove_out);
+    }
+    else if (m.opponent_out)
+    {
+        ++results.wins;
+        ++(pushed ? results.opponent_pushed_out : results.opponent_drove_out);
+    }
+    else
+    {
+        ++results.draws;
+    }
+    if (m.robot_out || m.opponent_out)
+    {
+        results.decision_s += m.t > m.start_s ? m.t - m.start_s : 0;
+    }
+}
+
+// Play this worker's share of matches against every opponent, one batch per
+// opponent.
+static void run_worker(
+    unsigned int worker,
+    unsigned int workers,
+    unsigned long matches,
+    Results * results
+)
+{
+    unsigned long const share =
+        matches > worker ? (matches - worker + workers - 1) / workers : 0;
+
+    for (unsigned int o = 0; o < OPPONENT_COUNT; ++o)
+    {
+        results[o] = Results();
+        std::vector<Match> batch(share);
+        for (unsigned long j = 0; j < share; ++j)
+        {
+            unsigned long const i = worker + j * workers;
+            uint32_t const seed = (o << 24) ^ (i * 2654435761u);
+            start_match(batch[j], static_cast<Opponent>(o), seed);
+        }
+
+        // Run each match to the end in turn. Stepping the whole batch round
+        // robin gives the same results, but is slower once the batch
+        // outgrows the cache.
+        for (Match & m : batch)
+        {
+            while (!finished(m))
+            {
+                step_match(m);
+            }
+            score_match(m, results[o]);
+        }
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    unsigned long const matches =
+        argc > 1 ? strtoul(argv[1], nullptr, 0) : 1000;
+    long const cores = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int const workers = argc > 2 ?
+        strtoul(argv[2], nullptr, 0) : (cores > 0 ? cores : 1);
+
+    Clock::time_point const start = Clock::now();
+
+    // Start the workers, each filling in its own results.
+    std::vector<Results> results(workers * OPPONENT_COUNT);
+    std::vector<std::thread> threads;
+    for (unsigned int w = 0; w < workers; ++w)
+    {
+        Results * const r = &results[w * OPPONENT_COUNT];
+        threads.push_back(std::thread(run_worker, w, workers, matches, r));
+    }
+
+    Results totals[OPPONENT_COUNT] = {};
+    for (unsigned int w = 0; w < workers; ++w)
+    {
+        threads[w].join();
+        for (unsigned int o = 0; o < OPPONENT_COUNT; ++o)
+        {
+            Results & t = totals[o];
+            Results const & r = results[w * OPPONENT_COUNT + o];
+            t.matches += r.matches;
+            t.wins += r.wins;
+            t.losses += r.losses;
+            t.draws += r.draws;
+            t.robot_pushed_out += r.robot_pushed_out;
+            t.robot_drove_out += r.robot_drove_out;
+            t.opponent_pushed_out += r.opponent_pushed_out;
+            t.opponent_drove_out += r.opponent_drove_out;
+            t.decision_s += r.decision_s;
+        }
+    }
+    double const seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+
+    printf(
+        "%lu matches per opponent, %.0f s limit, %u workers\n",
+        matches,
+        MATCH_S,
+        workers
+    );
+    printf(
+        "%-8s %6s %6s %6s   %-13s %-13s %s\n",
+        "opponent",
+        "win",
+        "loss",
+        "draw",
+        "robot out",
+        "opponent out",
+        "mean decision"
+    );
+    printf(
+        "%-8s %6s %6s %6s   %-13s %-13s\n",
+        "",
+        "",
+        "",
+        "",
+        "pushed/drove",
+        "pushed/drove"
+    );
+    unsigned long total = 0;
+    for (unsigned int o = 0; o < OPPONENT_COUNT; ++o)
+    {
+        Results const & r = totals[o];
+        unsigned long const decided = r.wins + r.losses;
+        printf(
+            "%-8s %5.1f%% %5.1f%% %5.1f%%   %6lu/%-6lu %6lu/%-6lu",
+            opponent_names[o],
+            100.0 * r.wins / r.matches,
+            100.0 * r.losses / r.matches,
+            100.0 * r.draws / r.matches,
+            r.robot_pushed_out,
+            r.robot_drove_out,
+            r.opponent_pushed_out,
+            r.opponent_drove_out
+        );
+        if (decided)
+        {
+            printf(" %.2f s", r.decision_s / decided);
+        }
+        printf("\n");
+        total += r.matches;
+    }
+    printf(
+        "%lu matches in %.2f s, %.0f matches/sec\n",
+        total,
+        seconds,
+        total / seconds
+    );
+
+    return 0;
+}
@@ -0,0 +1,19 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+// Minimal Arduino core for the host simulation build. Time functions are
+// backed by the simulation clock in sim.h.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
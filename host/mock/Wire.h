@@ -0,0 +1,80 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+// Arduino Wire (I2C) library, on the simulated bus of sim.h. Only the calls
+// the sketch makes are provided.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sim.h"
+
+// Transfer buffer size, as in the AVR Wire library. Longer transfers are
+// truncated.
+#define BUFFER_LENGTH 32
+
+class TwoWire
+{
+public:
+    TwoWire() : m_address(0), m_tx_length(0), m_rx_length(0), m_rx_index(0)
+    {}
+
+    void begin() {}
+    void setClock(uint32_t clock) { sim::hardware().i2c_clock_hz = clock; }
+
+    void beginTransmission(uint8_t address)
+    {
+        m_address = address;
+        m_tx_length = 0;
+    }
+
+    size_t write(uint8_t data)
+    {
+        if (m_tx_length == BUFFER_LENGTH)
+        {
+            return 0;
+        }
+        m_tx_buffer[m_tx_length++] = data;
+        return 1;
+    }
+
+    // 0 on success, 2 if the address is not acknowledged.
+    uint8_t endTransmission(bool stop = true)
+    {
+        (void)stop;
+        return sim::i2c_write(m_address, m_tx_buffer, m_tx_length) ? 0 : 2;
+    }
+
+    uint8_t requestFrom(uint8_t address, uint8_t quantity)
+    {
+        if (quantity > BUFFER_LENGTH)
+        {
+            quantity = BUFFER_LENGTH;
+        }
+        m_rx_length = sim::i2c_read(address, m_rx_buffer, quantity);
+        m_rx_index = 0;
+        return m_rx_length;
+    }
+
+    int available() { return m_rx_length - m_rx_index; }
+
+    int read()
+    {
+        return m_rx_index < m_rx_length ? m_rx_buffer[m_rx_index++] : -1;
+    }
+
+private:
+    uint8_t m_address;
+    uint8_t m_tx_buffer[BUFFER_LENGTH];
+    uint8_t m_tx_length;
+    uint8_t m_rx_buffer[BUFFER_LENGTH];
+    uint8_t m_rx_length;
+    uint8_t m_rx_index;
+};
+
+// One bus per thread, as each thread runs its own simulated robots.
+extern thread_local TwoWire Wire;
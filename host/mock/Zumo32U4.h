@@ -0,0 +1,344 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+// Host stand-ins for the Pololu Zumo32U4 library classes used by the sketch.
+// Only the parts of each interface the sketch calls are provided. All I/O goes
+// through the `sim::Hardware` selected for the calling thread.
+
+#include "Arduino.h"
+#include "sim.h"
+
+// LSM303D accelerometer registers on the simulated I2C bus. The magnetometer
+// is not modelled.
+class LSM303
+{
+public:
+    template <typename T> struct vector { T x, y, z; };
+
+    enum regAddr
+    {
+        WHO_AM_I = 0x0F,
+        CTRL0 = 0x1F,
+        CTRL1 = 0x20,
+        CTRL2 = 0x21,
+        OUT_X_L_A = 0x28,
+        FIFO_CTRL = 0x2E,
+        FIFO_SRC = 0x2F
+    };
+
+    LSM303() : a(), m() {}
+
+    bool init() { return readReg(WHO_AM_I) == 0x49; }
+
+    void enableDefault()
+    {
+        writeReg(CTRL2, 0x00);
+        writeReg(CTRL1, 0x57);
+    }
+
+    void writeReg(uint8_t reg, uint8_t value)
+    {
+        uint8_t const data[2] = {reg, value};
+        sim::i2c_write(sim::LSM303D_ADDRESS, data, 2);
+    }
+
+    uint8_t readReg(int reg)
+    {
+        uint8_t const address = reg;
+        uint8_t value = 0;
+        sim::i2c_write(sim::LSM303D_ADDRESS, &address, 1);
+        sim::i2c_read(sim::LSM303D_ADDRESS, &value, 1);
+        return value;
+    }
+
+    void readAcc()
+    {
+        uint8_t const address = OUT_X_L_A | 0x80;
+        uint8_t data[6] = {0};
+        sim::i2c_write(sim::LSM303D_ADDRESS, &address, 1);
+        sim::i2c_read(sim::LSM303D_ADDRESS, data, 6);
+        a.x = static_cast<int16_t>(data[1] << 8 | data[0]);
+        a.y = static_cast<int16_t>(data[3] << 8 | data[2]);
+        a.z = static_cast<int16_t>(data[5] << 8 | data[4]);
+    }
+
+    void read() { readAcc(); }
+
+    vector<int16_t> a;
+    vector<int16_t> m;
+};
+
+// L3GD20H gyro registers on the simulated I2C bus.
+class L3G
+{
+public:
+    template <typename T> struct vector { T x, y, z; };
+
+    enum regAddr
+    {
+        WHO_AM_I = 0x0F,
+        CTRL1 = 0x20,
+        CTRL4 = 0x23,
+        CTRL5 = 0x24,
+        OUT_X_L = 0x28,
+        FIFO_CTRL = 0x2E,
+        FIFO_SRC = 0x2F,
+        LOW_ODR = 0x39
+    };
+
+    L3G() : g() {}
+
+    bool init() { return readReg(WHO_AM_I) == 0xD7; }
+
+    void enableDefault()
+    {
+        writeReg(LOW_ODR, 0x00);
+        writeReg(CTRL4, 0x00);
+        writeReg(CTRL1, 0x6F);
+    }
+
+    void writeReg(uint8_t reg, uint8_t value)
+    {
+        uint8_t const data[2] = {reg, value};
+        sim::i2c_write(sim::L3GD20H_ADDRESS, data, 2);
+    }
+
+    uint8_t readReg(int reg)
+    {
+        uint8_t const address = reg;
+        uint8_t value = 0;
+        sim::i2c_write(sim::L3GD20H_ADDRESS, &address, 1);
+        sim::i2c_read(sim::L3GD20H_ADDRESS, &value, 1);
+        return value;
+    }
+
+    void read()
+    {
+        uint8_t const address = OUT_X_L | 0x80;
+        uint8_t data[6] = {0};
+        sim::i2c_write(sim::L3GD20H_ADDRESS, &address, 1);
+        sim::i2c_read(sim::L3GD20H_ADDRESS, data, 6);
+        g.x = static_cast<int16_t>(data[1] << 8 | data[0]);
+        g.y = static_cast<int16_t>(data[3] << 8 | data[2]);
+        g.z = static_cast<int16_t>(data[5] << 8 | data[4]);
+    }
+
+    vector<int16_t> g;
+};
+
+class Zumo32U4ButtonA
+{
+public:
+    bool isPressed() { return false; }
+    bool getSingleDebouncedPress() { return false; }
+};
+
+class Zumo32U4ButtonB
+{
+public:
+    Zumo32U4ButtonB() : m_was_pressed(false) {}
+
+    bool isPressed() { return sim::hardware().start_button; }
+
+    // Returns true once per press.
+    bool getSingleDebouncedPress()
+    {
+        bool pressed = isPressed();
+        bool press = pressed && !m_was_pressed;
+        m_was_pressed = pressed;
+        return press;
+    }
+
+private:
+    bool m_was_pressed;
+};
+
+class Zumo32U4ButtonC
+{
+public:
+    bool isPressed() { return false; }
+    bool getSingleDebouncedPress() { return false; }
+};
+
+class Zumo32U4Buzzer
+{
+public:
+    void playFrequency(unsigned int, unsigned int, unsigned char) {}
+    void stopPlaying() {}
+};
+
+class Zumo32U4Encoders
+{
+public:
+    int16_t getCountsLeft() { return sim::hardware().encoder_left; }
+    int16_t getCountsRight() { return sim::hardware().encoder_right; }
+
+    int16_t getCountsAndResetLeft()
+    {
+        int16_t counts = sim::hardware().encoder_left;
+        sim::hardware().encoder_left = 0;
+        return counts;
+    }
+
+    int16_t getCountsAndResetRight()
+    {
+        int16_t counts = sim::hardware().encoder_right;
+        sim::hardware().encoder_right = 0;
+        return counts;
+    }
+
+    bool checkErrorLeft() { return false; }
+    bool checkErrorRight() { return false; }
+};
+
+class Zumo32U4IRPulses
+{
+};
+
+class Zumo32U4LCD
+{
+public:
+    void clear()
+    {
+        sim::Hardware & hw = sim::hardware();
+        memset(hw.lcd[0], ' ', 8);
+        memset(hw.lcd[1], ' ', 8);
+        hw.lcd_x = hw.lcd_y = 0;
+        sim::advance_us(sim::LCD_CLEAR_US);
+    }
+
+    void gotoXY(uint8_t x, uint8_t y)
+    {
+        sim::hardware().lcd_x = x;
+        sim::hardware().lcd_y = y & 1;
+        sim::advance_us(sim::LCD_CHAR_US);
+    }
+
+    size_t write(uint8_t c)
+    {
+        sim::Hardware & hw = sim::hardware();
+        if (hw.lcd_x < 8)
+        {
+            hw.lcd[hw.lcd_y][hw.lcd_x] = c;
+        }
+        ++hw.lcd_x;
+        ++hw.lcd_writes;
+        sim::advance_us(sim::LCD_CHAR_US);
+        return 1;
+    }
+
+    size_t write(char const * str, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            write(static_cast<uint8_t>(str[i]));
+        }
+        return size;
+    }
+
+    size_t print(char const * str) { return write(str, strlen(str)); }
+};
+
+// Reading modes accepted by Zumo32U4LineSensors::read().
+#define QTR_EMITTERS_OFF 0
+#define QTR_EMITTERS_ON 1
+
+class Zumo32U4LineSensors
+{
+public:
+    Zumo32U4LineSensors() : m_sensor_count(0) {}
+
+    void initThreeSensors() { m_sensor_count = 3; }
+    void initFiveSensors() { m_sensor_count = 5; }
+
+    // RC sensors are read by timing capacitor decay, so the read blocks for
+    // as long as the darkest sensor takes, up to the timeout.
+    void read(unsigned int * sensor_values, unsigned char read_mode = QTR_EMITTERS_ON)
+    {
+        (void)read_mode;
+        sim::Hardware & hw = sim::hardware();
+        unsigned long longest = 0;
+        for (uint8_t i = 0; i < m_sensor_count; ++i)
+        {
+            // Three sensor configuration uses DN1, DN3 and DN5.
+            unsigned int value = hw.line[m_sensor_count == 3 ? i * 2 : i];
+            if (value > sim::LINE_SENSOR_TIMEOUT_US)
+            {
+                value = sim::LINE_SENSOR_TIMEOUT_US;
+            }
+            sensor_values[i] = value;
+            if (value > longest)
+            {
+                longest = value;
+            }
+        }
+        sim::advance_us(longest);
+        hw.line_read_us = sim::now_us();
+    }
+
+private:
+    uint8_t m_sensor_count;
+};
+
+class Zumo32U4Motors
+{
+public:
+    static void setSpeeds(int16_t left_speed, int16_t right_speed)
+    {
+        sim::Hardware & hw = sim::hardware();
+        hw.motor_left = left_speed;
+        hw.motor_right = right_speed;
+        ++hw.motor_writes;
+        sim::advance_us(sim::MOTOR_WRITE_US);
+        hw.motor_write_us = sim::now_us();
+    }
+
+    static void setLeftSpeed(int16_t speed)
+    {
+        setSpeeds(speed, sim::hardware().motor_right);
+    }
+
+    static void setRightSpeed(int16_t speed)
+    {
+        setSpeeds(sim::hardware().motor_left, speed);
+    }
+};
+
+class Zumo32U4ProximitySensors
+{
+public:
+    Zumo32U4ProximitySensors() :
+        m_front_left(0), m_front_right(0), m_left(0), m_right(0)
+    {}
+
+    void initFrontSensor() {}
+    void initThreeSensors() {}
+
+    // Latches the simulated counts, and charges the time the real driver
+    // spends pulsing the IR emitters.
+    void read()
+    {
+        sim::Hardware const & hw = sim::hardware();
+        m_front_left = hw.proximity_front_left;
+        m_front_right = hw.proximity_front_right;
+        m_left = hw.proximity_left;
+        m_right = hw.proximity_right;
+        sim::advance_us(sim::PROXIMITY_READ_US);
+    }
+
+    uint8_t countsFrontWithLeftLeds() { return m_front_left; }
+    uint8_t countsFrontWithRightLeds() { return m_front_right; }
+    uint8_t countsLeftWithLeftLeds() { return m_left; }
+    uint8_t countsRightWithRightLeds() { return m_right; }
+
+private:
+    uint8_t m_front_left;
+    uint8_t m_front_right;
+    uint8_t m_left;
+    uint8_t m_right;
+};
@@ -0,0 +1,33 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+// AVR program memory access, for the host simulation build. The host has one
+// address space, so program memory is ordinary memory and its reads are
+// plain reads. Only the calls the sketch makes are provided.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+inline uint8_t pgm_read_byte(void const * address)
+{
+    return *static_cast<uint8_t const *>(address);
+}
+
+inline char * strncpy_P(char * dest, char const * src, size_t n)
+{
+    return strncpy(dest, src, n);
+}
+
+inline size_t strlen_P(char const * s)
+{
+    return strlen(s);
+}
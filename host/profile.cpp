@@ -0,0 +1,80 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// Loop profile.
+//
+// Runs the sketch, built with PROFILING, against the simulated hardware for a
+// number of simulated seconds, then dumps the profiler's histograms. Times are
+// in modelled microseconds, as micros() reads them in the simulator, so
+// sensor reads and LCD writes show their modelled cost and state handlers,
+// which the simulator does not charge for, read as 0.
+//
+// Also reports the host cost of a probe.
+//
+// Usage: profile [seconds]
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include "profiler.h"
+#include "sim.h"
+
+// Defined in sumobot-template.ino.
+void setup();
+void loop();
+
+typedef std::chrono::steady_clock Clock;
+
+// Profiler output to stdout, in the shape of Arduino's Serial.
+struct StdoutPrinter
+{
+    void print(char const * s) { fputs(s, stdout); }
+    void print(unsigned long n) { printf("%lu", n); }
+    void println() { putchar('\n'); }
+};
+
+static uint32_t seed = 1;
+
+int main(int argc, char ** argv)
+{
+    unsigned long const seconds =
+        argc > 1 ? strtoul(argv[1], nullptr, 0) : 10;
+    unsigned long const probes = 10000000;
+    sim::Hardware & hw = sim::hardware();
+    StdoutPrinter out;
+
+    // Probe cost on the host.
+    Clock::time_point start = Clock::now();
+    for (unsigned long i = 0; i < probes; ++i)
+    {
+        PROFILE_SCOPE(PROFILE_LOOP);
+    }
+    double const probe_ns = std::chrono::duration<double, std::nano>(
+        Clock::now() - start
+    ).count() / probes;
+
+    profiler.reset();
+    setup();
+
+    unsigned long loops = 0;
+    unsigned long const end_us = sim::now_us() + seconds * 1000000UL;
+    start = Clock::now();
+    while (sim::now_us() < end_us)
+    {
+        sim::step_noisy(hw, loops++, seed);
+        loop();
+    }
+    double const loop_ns = std::chrono::duration<double, std::nano>(
+        Clock::now() - start
+    ).count() / loops;
+
+    printf("%lu loops in %lu simulated seconds, times in us\n", loops, seconds);
+    profiler.dump(out);
+    printf("host cost: %.1f ns per probe, %.1f ns per loop\n", probe_ns, loop_ns);
+
+    return 0;
+}
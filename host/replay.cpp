@@ -0,0 +1,315 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// Trace decoder and replay.
+//
+// Decodes a trace written by `Trace::dump()`, and replays its events into the
+// sketch's state machine, built with TRACING, checking that the replay takes
+// the same transitions as the recording. Replay dispatches the recorded events
+// directly, with the simulated clock set to each record's time, so it does not
+// depend on sensor input and runs as fast as the host allows.
+//
+// The machine is first put in the state it was in at the first recorded event:
+// the target of the last transition before it or, if the trace starts with
+// events, the source of the first transition after them.
+//
+// Usage:
+//   replay [-v] FILE            decode (-v: list every record) and replay
+//   replay record FILE [secs]   run the sketch against simulated input and
+//                               write its trace to FILE
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "robotstatemachine.h"
+#include "sim.h"
+#include "trace.h"
+
+// Defined in sumobot-template.ino.
+extern RobotStateMachine machine;
+void setup();
+void loop();
+
+typedef std::chrono::steady_clock Clock;
+
+// Trace output to a file, in the shape of Arduino's Serial.
+struct FilePrinter
+{
+    explicit FilePrinter(FILE * f) : file(f) {}
+    void write(uint8_t const * data, size_t size)
+    {
+        fwrite(data, 1, size, file);
+    }
+
+    FILE * file;
+};
+
+static uint32_t seed = 1;
+
+static int record(char const * path, unsigned long seconds)
+{
+    FILE * f = fopen(path, "wb");
+    if (!f)
+    {
+        perror(path);
+        return 1;
+    }
+
+    sim::Hardware & hw = sim::hardware();
+    setup();
+    unsigned long loops = 0;
+    unsigned long const end_us = sim::now_us() + seconds * 1000000UL;
+    while (sim::now_us() < end_us)
+    {
+        sim::step_noisy(hw, loops++, seed);
+        loop();
+    }
+
+    FilePrinter out(f);
+    trace.dump(out);
+    fclose(f);
+    printf(
+        "%lu loops, %u records written, %lu dropped\n",
+        loops,
+        trace.size(),
+        static_cast<unsigned long>(trace.dropped())
+    );
+
+    return 0;
+}
+
+static bool load(
+    char const * path,
+    TraceHeader & header,
+    std::vector<TraceRecord> & records
+)
+{
+    FILE * f = fopen(path, "rb");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+        trace_header_valid(header);
+    if (ok)
+    {
+        records.resize(header.count);
+        ok = fread(records.data(), sizeof(TraceRecord), header.count, f) ==
+            header.count;
+    }
+    fclose(f);
+    if (!ok)
+    {
+        fprintf(stderr, "%s: not a version %u trace\n", path, TRACE_VERSION);
+    }
+
+    return ok;
+}
+
+static void list(std::vector<TraceRecord> const & records)
+{
+    for (TraceRecord const & r : records)
+    {
+        RobotEventSlot slot;
+        printf("%10lu us  ", static_cast<unsigned long>(r.time_us));
+        if (trace_decode_event(r, slot))
+        {
+            printf(
+                "event %-5s %u %u %u\n",
+                slot.event().m_name,
+                r.data[0],
+                r.data[1],
+                r.data[2]
+            );
+        }
+        else if (r.type == TRACE_TRANSITION_RECORD)
+        {
+            printf("transition %u -> %u\n", r.data[0], r.data[1]);
+        }
+        else
+        {
+            printf("unknown record type %u\n", r.type);
+        }
+    }
+}
+
+// Index of the state the machine was in at the event record `first_event`,
+// or 0xFF if the trace has no transitions.
+static uint8_t initial_state(
+    std::vector<TraceRecord> const & records,
+    size_t first_event
+)
+{
+    uint8_t state = 0xFF;
+    for (size_t i = 0; i < first_event; ++i)
+    {
+        state = records[i].data[1];
+    }
+    for (size_t i = first_event; state == 0xFF && i < records.size(); ++i)
+    {
+        if (records[i].type == TRACE_TRANSITION_RECORD)
+        {
+            state = records[i].data[0];
+        }
+    }
+
+    return state;
+}
+
+// Replay the events in `records`, from the first event on, once.
+static void replay_events(
+    std::vector<TraceRecord> const & records,
+    size_t first_event,
+    uint8_t initial
+)
+{
+    if (State * s = machine.state_at(initial))
+    {
+        machine.transition_to_state(*s);
+    }
+    trace.reset();
+
+    for (size_t i = first_event; i < records.size(); ++i)
+    {
+        RobotEventSlot slot;
+        if (trace_decode_event(records[i], slot))
+        {
+            sim::set_now_us(records[i].time_us);
+            trace.event(slot);
+            machine.handle_event(slot.event());
+        }
+    }
+}
+
+static int replay(char const * path, bool verbose)
+{
+    TraceHeader header;
+    std::vector<TraceRecord> records;
+    if (!load(path, header, records))
+    {
+        return 1;
+    }
+    if (verbose)
+    {
+        list(records);
+    }
+
+    // Recorded events and transitions, from the first event on.
+    size_t first_event = records.size();
+    std::vector<TraceRecord> expected;
+    unsigned long events = 0;
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        bool const is_event = records[i].type != TRACE_TRANSITION_RECORD;
+        if (is_event && first_event == records.size())
+        {
+            first_event = i;
+        }
+        if (first_event != records.size())
+        {
+            expected.push_back(records[i]);
+            events += is_event;
+        }
+    }
+    if (!events)
+    {
+        printf("%s: no events to replay\n", path);
+        return 0;
+    }
+
+    uint8_t const initial = initial_state(records, first_event);
+    setup();
+
+    // Check one replay against the recording.
+    replay_events(records, first_event, initial);
+    size_t mismatch = expected.size();
+    if (trace.size() != expected.size())
+    {
+        mismatch = std::min<size_t>(trace.size(), expected.size());
+    }
+    for (size_t i = 0; i < std::min<size_t>(trace.size(), expected.size()); ++i)
+    {
+        TraceRecord const & a = trace.record(i);
+        TraceRecord const & b = expected[i];
+        if (a.type != b.type || memcmp(a.data, b.data, sizeof(a.data)) != 0)
+        {
+            mismatch = i;
+            break;
+        }
+    }
+
+    // Time repeated replays.
+    unsigned int const passes = 1000;
+    Clock::time_point const start = Clock::now();
+    for (unsigned int i = 0; i < passes; ++i)
+    {
+        replay_events(records, first_event, initial);
+    }
+    double const seconds =
+        std::chrono::duration<double>(Clock::now() - start).count() / passes;
+    double const recorded_seconds =
+        static_cast<uint32_t>(expected.back().time_us - expected[0].time_us) /
+        1e6;
+
+    printf(
+        "%s: %u records (%lu dropped before the dump), %lu events replayed "
+        "from state %u\n",
+        path,
+        header.count,
+        static_cast<unsigned long>(header.dropped),
+        events,
+        initial
+    );
+    if (mismatch == expected.size())
+    {
+        printf("  replay matches the recording\n");
+    }
+    else
+    {
+        printf(
+            "  replay diverges at record %lu of %lu\n",
+            static_cast<unsigned long>(first_event + mismatch),
+            static_cast<unsigned long>(records.size())
+        );
+    }
+    printf(
+        "  %.1f us per replay of %.3f recorded seconds, %.0fx real time\n",
+        seconds * 1e6,
+        recorded_seconds,
+        recorded_seconds / seconds
+    );
+
+    return mismatch == expected.size() ? 0 : 2;
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc >= 3 && strcmp(argv[1], "record") == 0)
+    {
+        return record(argv[2], argc > 3 ? strtoul(argv[3], nullptr, 0) : 10);
+    }
+    if (argc == 3 && strcmp(argv[1], "-v") == 0)
+    {
+        return replay(argv[2], true);
+    }
+    if (argc == 2)
+    {
+        return replay(argv[1], false);
+    }
+
+    fprintf(
+        stderr,
+        "usage: replay [-v] FILE\n"
+        "       replay record FILE [seconds]\n"
+    );
+    return 1;
+}
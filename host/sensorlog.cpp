@@ -0,0 +1,130 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sensorlog.h"
+
+namespace sim
+{
+    SensorLogHeader sensor_log_header()
+    {
+        SensorLogHeader header =
+        {
+            {'S', 'B', 'S', 'L'},
+            SENSOR_LOG_VERSION,
+            sizeof(SensorLogRecord),
+            0
+        };
+        return header;
+    }
+
+    void apply(SensorLogRecord const & record, Hardware & hw)
+    {
+        set_now_us(record.time_us);
+
+        hw.start_button = record.buttons & 1;
+        for (unsigned int i = 0; i < 5; ++i)
+        {
+            hw.line[i] = record.line[i];
+        }
+        hw.encoder_left += record.encoder_left;
+        hw.encoder_right += record.encoder_right;
+        hw.proximity_front_left = record.proximity_front_left;
+        hw.proximity_front_right = record.proximity_front_right;
+        hw.proximity_left = record.proximity_left;
+        hw.proximity_right = record.proximity_right;
+    }
+
+    SensorLog::SensorLog() :
+        m_map(nullptr),
+        m_map_size(0),
+        m_records(nullptr),
+        m_size(0)
+    {}
+
+    SensorLog::~SensorLog()
+    {
+        close();
+    }
+
+    bool SensorLog::open(char const * path)
+    {
+        close();
+
+        int const fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            perror(path);
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            perror(path);
+            ::close(fd);
+            return false;
+        }
+
+        size_t const size = st.st_size;
+        void * map = size >= sizeof(SensorLogHeader) ?
+            mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (map == MAP_FAILED)
+        {
+            fprintf(stderr, "%s: cannot map\n", path);
+            return false;
+        }
+
+        SensorLogHeader const & header =
+            *static_cast<SensorLogHeader const *>(map);
+        SensorLogHeader const expected = sensor_log_header();
+        if (
+            memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+            header.version != expected.version ||
+            header.record_size != expected.record_size
+        )
+        {
+            fprintf(
+                stderr,
+                "%s: not a version %u sensor log\n",
+                path,
+                SENSOR_LOG_VERSION
+            );
+            munmap(map, size);
+            return false;
+        }
+
+        // Replay reads front to back.
+        madvise(map, size, MADV_SEQUENTIAL);
+
+        m_map = map;
+        m_map_size = size;
+        m_records = reinterpret_cast<SensorLogRecord const *>(
+            static_cast<char const *>(map) + sizeof(SensorLogHeader)
+        );
+        m_size = (size - sizeof(SensorLogHeader)) / sizeof(SensorLogRecord);
+
+        return true;
+    }
+
+    void SensorLog::close()
+    {
+        if (m_map)
+        {
+            munmap(m_map, m_map_size);
+        }
+        m_map = nullptr;
+        m_map_size = 0;
+        m_records = nullptr;
+        m_size = 0;
+    }
+}
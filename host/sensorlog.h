@@ -0,0 +1,94 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sim.h"
+
+// Recorded sensor input, for replay through the simulated hardware.
+//
+// A sensor log is a `SensorLogHeader` followed by one `SensorLogRecord` per
+// pass of `loop()`, holding the raw inputs `IRobot` reads on that pass.
+// Multi-byte fields are little-endian, as written by the robot.
+namespace sim
+{
+    struct SensorLogHeader
+    {
+        char magic[4];
+        uint8_t version;
+        uint8_t record_size;
+        uint16_t reserved;
+    };
+
+    struct SensorLogRecord
+    {
+        // micros() at the start of the pass.
+        uint32_t time_us;
+
+        // Line sensor readings, left to right.
+        uint16_t line[5];
+
+        // Encoder counts since the previous record.
+        int16_t encoder_left;
+        int16_t encoder_right;
+
+        // Proximity brightness counts.
+        uint8_t proximity_front_left;
+        uint8_t proximity_front_right;
+        uint8_t proximity_left;
+        uint8_t proximity_right;
+
+        // Bit 0: start button pressed.
+        uint8_t buttons;
+        uint8_t reserved;
+    };
+
+    static_assert(sizeof(SensorLogRecord) == 24, "Records must be 24 bytes.");
+
+    uint8_t const SENSOR_LOG_VERSION = 1;
+
+    // Header for a new log.
+    SensorLogHeader sensor_log_header();
+
+    // Load the inputs of `record` into `hw`, and set the virtual clock to its
+    // time, so the modelled time of the sensor reads does not drift the clock
+    // ahead of the log. The wheel model should be off (see
+    // `Hardware::counts_per_speed_s`), so the encoders count only as logged.
+    void apply(SensorLogRecord const & record, Hardware & hw);
+
+    // Read-only view of a sensor log file, memory mapped so logs of any
+    // length are paged in as they are replayed rather than loaded up front.
+    class SensorLog
+    {
+    public:
+        SensorLog();
+        ~SensorLog();
+
+        // Map the log at `path`. Prints the reason and returns `false` if it
+        // cannot be opened or is not a sensor log.
+        bool open(char const * path);
+        void close();
+
+        // Number of records.
+        size_t size() const { return m_size; }
+
+        SensorLogRecord const & operator[](size_t i) const
+        {
+            return m_records[i];
+        }
+
+    private:
+        SensorLog(SensorLog const &);
+        SensorLog & operator=(SensorLog const &);
+
+        void * m_map;
+        size_t m_map_size;
+        SensorLogRecord const * m_records;
+        size_t m_size;
+    };
+}
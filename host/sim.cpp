@@ -0,0 +1,470 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include <math.h>
+#include <string.h>
+#include "Arduino.h"
+#include "Wire.h"
+#include "sim.h"
+
+thread_local TwoWire Wire;
+
+namespace sim
+{
+    static thread_local Hardware default_hardware;
+    static thread_local Hardware * selected_hardware = &default_hardware;
+
+    Hardware::Hardware() :
+        clock_us(0),
+        start_button(false),
+        line_read_us(0),
+        proximity_front_left(0),
+        proximity_front_right(0),
+        proximity_left(0),
+        proximity_right(0),
+        encoder_left(0),
+        encoder_right(0),
+        counts_per_speed_s(12.5),
+        travel_left(0.0),
+        travel_right(0.0),
+        motor_deadband(0.0),
+        motor_droop(0.0),
+        motor_gain_left(1.0),
+        motor_gain_right(1.0),
+        motor_time_constant_s(0.0),
+        wheel_speed_left(0.0),
+        wheel_speed_right(0.0),
+        odometer_left(0),
+        odometer_right(0),
+        motor_left(0),
+        motor_right(0),
+        motor_writes(0),
+        motor_write_us(0),
+        i2c_clock_hz(100000),
+        i2c_bytes(0),
+        gyro_bias(0),
+        degrees_per_count(360.0 / (3.14159265358979 * 88.0 * 7.5)),
+        tread_slip(0.0),
+        yaw_rate(0.0),
+        heading(0.0),
+        lcd_x(0),
+        lcd_y(0),
+        lcd_writes(0)
+    {
+        for (unsigned int & value : line)
+        {
+            value = LINE_SENSOR_TIMEOUT_US;
+        }
+        memset(lcd, ' ', sizeof(lcd));
+        lcd[0][8] = lcd[1][8] = '\0';
+    }
+
+    // Steady wheel speed for motor command `command`.
+    static double motor_response(
+        Hardware const & hw,
+        int16_t command,
+        double gain
+    )
+    {
+        double x = command < 0 ? -command : command;
+        if (x <= hw.motor_deadband)
+        {
+            return 0.0;
+        }
+        if (hw.motor_deadband)
+        {
+            x = (x - hw.motor_deadband) * 400.0 / (400.0 - hw.motor_deadband);
+        }
+        x -= hw.motor_droop * x * (400.0 - x) / 400.0;
+        return command < 0 ? -gain * x : gain * x;
+    }
+
+    Imu::Imu() :
+        pointer(0),
+        fifo_level(0),
+        overrun(false),
+        next_us(0),
+        samples(0)
+    {
+        memset(value, 0, sizeof(value));
+        memset(registers, 0, sizeof(registers));
+        memset(output, 0, sizeof(output));
+        memset(fifo, 0, sizeof(fifo));
+    }
+
+    // Registers shared by the LSM303D and L3GD20H.
+    static uint8_t const WHO_AM_I = 0x0F;
+    static uint8_t const CTRL1 = 0x20;
+    static uint8_t const OUT_X_L = 0x28;
+    static uint8_t const OUT_Z_H = 0x2D;
+    static uint8_t const FIFO_CTRL = 0x2E;
+    static uint8_t const FIFO_SRC = 0x2F;
+
+    // What differs between them: identity, the register holding FIFO_EN,
+    // and the sample period (0 if powered down) set in their registers.
+    struct ImuModel
+    {
+        uint8_t who_am_i;
+        uint8_t fifo_enable_register;
+        unsigned long (*period_us)(uint8_t const * registers);
+    };
+
+    static unsigned long accelerometer_period_us(uint8_t const * registers)
+    {
+        uint8_t const rate = registers[CTRL1] >> 4;
+        if (rate == 0)
+        {
+            return 0;
+        }
+        // 3.125 Hz, doubling up to 1600 Hz.
+        return 320000UL >> ((rate < 10 ? rate : 10) - 1);
+    }
+
+    static unsigned long gyro_period_us(uint8_t const * registers)
+    {
+        // Powered up (PD) at 100 Hz, doubling up to 800 Hz. LOW_ODR is not
+        // modelled.
+        uint8_t const ctrl1 = registers[CTRL1];
+        return ctrl1 & 0x08 ? 10000UL >> (ctrl1 >> 6) : 0;
+    }
+
+    static ImuModel const LSM303D = {0x49, 0x1F, accelerometer_period_us};
+    static ImuModel const L3GD20H = {0xD7, 0x24, gyro_period_us};
+
+    // Sensor answering at `address`, if any.
+    static Imu * imu_at(
+        Hardware & hw,
+        uint8_t address,
+        ImuModel const ** model
+    )
+    {
+        switch (address)
+        {
+        case LSM303D_ADDRESS:
+            *model = &LSM303D;
+            return &hw.accelerometer;
+        case L3GD20H_ADDRESS:
+            *model = &L3GD20H;
+            return &hw.gyro;
+        default:
+            return nullptr;
+        }
+    }
+
+    static bool fifo_enabled(Imu const & imu, ImuModel const & model)
+    {
+        return (imu.registers[model.fifo_enable_register] & 0x40) &&
+            (imu.registers[FIFO_CTRL] & 0xE0);
+    }
+
+    // Take the samples due up to the current time.
+    static void sample_imu(Hardware & hw, Imu & imu, ImuModel const & model)
+    {
+        unsigned long const period = model.period_us(imu.registers);
+        if (period == 0)
+        {
+            return;
+        }
+
+        while (static_cast<long>(hw.clock_us - imu.next_us) >= 0)
+        {
+            int16_t sample[3] = {imu.value[0], imu.value[1], imu.value[2]};
+            if (imu.source)
+            {
+                imu.source(imu.next_us, sample);
+            }
+            memcpy(imu.output, sample, sizeof(sample));
+            if (fifo_enabled(imu, model))
+            {
+                if (imu.fifo_level == IMU_FIFO_SIZE)
+                {
+                    memmove(
+                        imu.fifo[0],
+                        imu.fifo[1],
+                        sizeof(imu.fifo[0]) * (IMU_FIFO_SIZE - 1)
+                    );
+                    --imu.fifo_level;
+                    imu.overrun = true;
+                }
+                memcpy(imu.fifo[imu.fifo_level++], sample, sizeof(sample));
+            }
+            ++imu.samples;
+            imu.next_us += period;
+        }
+    }
+
+    static void sample_imus(Hardware & hw)
+    {
+        sample_imu(hw, hw.accelerometer, LSM303D);
+        sample_imu(hw, hw.gyro, L3GD20H);
+    }
+
+    // Restart sampling from the current time.
+    static void restart_imu(Hardware & hw, Imu & imu, ImuModel const & model)
+    {
+        imu.next_us = hw.clock_us + model.period_us(imu.registers);
+    }
+
+    static uint8_t read_register(
+        Imu & imu,
+        ImuModel const & model,
+        uint8_t reg
+    )
+    {
+        if (reg >= OUT_X_L && reg <= OUT_Z_H)
+        {
+            bool const fifo = fifo_enabled(imu, model) && imu.fifo_level;
+            int16_t const * const sample = fifo ? imu.fifo[0] : imu.output;
+            uint8_t const offset = reg - OUT_X_L;
+            uint16_t const value = sample[offset / 2];
+            uint8_t const byte = offset & 1 ? value >> 8 : value & 0xFF;
+            if (fifo && reg == OUT_Z_H)
+            {
+                --imu.fifo_level;
+                memmove(
+                    imu.fifo[0],
+                    imu.fifo[1],
+                    sizeof(imu.fifo[0]) * imu.fifo_level
+                );
+                imu.overrun = false;
+            }
+            return byte;
+        }
+
+        switch (reg)
+        {
+        case WHO_AM_I:
+            return model.who_am_i;
+        case FIFO_SRC:
+        {
+            uint8_t const level = imu.fifo_level;
+            return (imu.overrun ? 0x40 : 0) | (level ? 0 : 0x20) |
+                (level < 0x1F ? level : 0x1F);
+        }
+        default:
+            return imu.registers[reg & 0x3F];
+        }
+    }
+
+    static void write_register(
+        Hardware & hw,
+        Imu & imu,
+        ImuModel const & model,
+        uint8_t reg,
+        uint8_t value
+    )
+    {
+        unsigned long const period = model.period_us(imu.registers);
+        imu.registers[reg & 0x3F] = value;
+        if (reg == CTRL1 && model.period_us(imu.registers) != period)
+        {
+            restart_imu(hw, imu, model);
+        }
+        if (!fifo_enabled(imu, model))
+        {
+            imu.fifo_level = 0;
+            imu.overrun = false;
+        }
+    }
+
+    // Charge the bus time of `bytes` bytes plus the address byte.
+    static void i2c_transfer(Hardware & hw, uint8_t bytes)
+    {
+        hw.i2c_bytes += bytes + 1;
+        advance_us((bytes + 1) * 9000000UL / hw.i2c_clock_hz);
+    }
+
+    bool i2c_write(uint8_t address, uint8_t const * data, uint8_t length)
+    {
+        Hardware & hw = hardware();
+        i2c_transfer(hw, length);
+        ImuModel const * model = nullptr;
+        Imu * const imu = imu_at(hw, address, &model);
+        if (!imu || length == 0)
+        {
+            return false;
+        }
+
+        bool const increment = data[0] & 0x80;
+        imu->pointer = data[0] & 0x7F;
+        for (uint8_t i = 1; i < length; ++i)
+        {
+            write_register(hw, *imu, *model, imu->pointer, data[i]);
+            if (increment)
+            {
+                imu->pointer = (imu->pointer + 1) & 0x3F;
+            }
+        }
+        // Keep the increment flag for the reads that follow.
+        imu->pointer |= data[0] & 0x80;
+        return true;
+    }
+
+    uint8_t i2c_read(uint8_t address, uint8_t * data, uint8_t length)
+    {
+        Hardware & hw = hardware();
+        i2c_transfer(hw, length);
+        ImuModel const * model = nullptr;
+        Imu * const imu = imu_at(hw, address, &model);
+        if (!imu)
+        {
+            return 0;
+        }
+
+        bool const increment = imu->pointer & 0x80;
+        uint8_t reg = imu->pointer & 0x7F;
+        for (uint8_t i = 0; i < length; ++i)
+        {
+            data[i] = read_register(*imu, *model, reg);
+            if (!increment)
+            {
+                continue;
+            }
+            if (reg == OUT_Z_H && fifo_enabled(*imu, *model))
+            {
+                reg = OUT_X_L;
+            }
+            else
+            {
+                reg = (reg + 1) & 0x3F;
+            }
+        }
+        imu->pointer = reg | (increment ? 0x80 : 0);
+        return length;
+    }
+
+    Hardware & hardware()
+    {
+        return *selected_hardware;
+    }
+
+    void select(Hardware & hw)
+    {
+        selected_hardware = &hw;
+    }
+
+    unsigned long now_us()
+    {
+        return selected_hardware->clock_us;
+    }
+
+    void set_now_us(unsigned long t)
+    {
+        Hardware & hw = hardware();
+        bool const forward = static_cast<long>(t - hw.clock_us) >= 0;
+        hw.clock_us = t;
+        if (forward)
+        {
+            sample_imus(hw);
+        }
+        else
+        {
+            restart_imu(hw, hw.accelerometer, LSM303D);
+            restart_imu(hw, hw.gyro, L3GD20H);
+        }
+    }
+
+    void advance_us(unsigned long us)
+    {
+        Hardware & hw = hardware();
+        hw.clock_us += us;
+
+        if (hw.counts_per_speed_s)
+        {
+            double const left_target =
+                motor_response(hw, hw.motor_left, hw.motor_gain_left);
+            double const right_target =
+                motor_response(hw, hw.motor_right, hw.motor_gain_right);
+            if (hw.motor_time_constant_s > 0)
+            {
+                double const k =
+                    1.0 - exp(-(us / 1e6) / hw.motor_time_constant_s);
+                hw.wheel_speed_left += (left_target - hw.wheel_speed_left) * k;
+                hw.wheel_speed_right +=
+                    (right_target - hw.wheel_speed_right) * k;
+            }
+            else
+            {
+                hw.wheel_speed_left = left_target;
+                hw.wheel_speed_right = right_target;
+            }
+
+            double const scale = hw.counts_per_speed_s * us / 1e6;
+            hw.travel_left += hw.wheel_speed_left * scale;
+            hw.travel_right += hw.wheel_speed_right * scale;
+            int16_t const left = static_cast<int16_t>(hw.travel_left);
+            int16_t const right = static_cast<int16_t>(hw.travel_right);
+            hw.encoder_left += left;
+            hw.encoder_right += right;
+            hw.odometer_left += left;
+            hw.odometer_right += right;
+            hw.travel_left -= left;
+            hw.travel_right -= right;
+
+            // Half the wheels' difference, in counts per second.
+            double const spin =
+                (hw.wheel_speed_right - hw.wheel_speed_left) / 2 *
+                hw.counts_per_speed_s;
+            hw.yaw_rate = spin * hw.degrees_per_count * (1.0 - hw.tread_slip);
+            hw.heading += hw.yaw_rate * us / 1e6;
+            hw.gyro.value[2] = static_cast<int16_t>(
+                lround(hw.yaw_rate * 1000.0 / 70.0) + hw.gyro_bias
+            );
+        }
+
+        sample_imus(hw);
+    }
+
+    uint32_t next(uint32_t & seed)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 16;
+    }
+
+    double uniform(uint32_t & seed, double low, double high)
+    {
+        return low + (high - low) * (next(seed) & 0xFFFF) / 65536.0;
+    }
+
+    void step_noisy(Hardware & hw, unsigned long loop, uint32_t & seed)
+    {
+        hw.start_button = loop >= 10 && loop < 20;
+
+        bool const boundary = next(seed) % 64 == 0;
+        unsigned int const side = next(seed) % 3;
+        for (unsigned int i = 0; i < 5; ++i)
+        {
+            bool const white = boundary && (side == 1 || i / 2 == side);
+            hw.line[i] = white ?
+                100 + next(seed) % 100 :
+                1500 + next(seed) % 500;
+        }
+
+        uint8_t const opponent = next(seed) % 7;
+        hw.proximity_front_left = opponent ? opponent - next(seed) % 2 : 0;
+        hw.proximity_front_right = opponent ? opponent - next(seed) % 2 : 0;
+    }
+}
+
+unsigned long millis()
+{
+    return sim::now_us() / 1000;
+}
+
+unsigned long micros()
+{
+    return sim::now_us();
+}
+
+void delay(unsigned long ms)
+{
+    sim::advance_us(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    sim::advance_us(us);
+}
@@ -0,0 +1,200 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <functional>
+#include <stdint.h>
+
+// Host-side stand-in for the Zumo32U4 hardware.
+//
+// The mock `Zumo32U4.h` classes do not hold any I/O state of their own. They
+// read and write the `Hardware` instance selected for the calling thread, so a
+// simulation drives the robot by filling in sensor values and reading back
+// motor and LCD output.
+//
+// Time is virtual, and each `Hardware` keeps its own clock. `millis()` and
+// `micros()` return the clock of the selected hardware, and the mock drivers
+// advance it by the approximate time the real driver would block for, so
+// virtual time tracks the modelled MCU time spent on I/O.
+//
+// To run several robots, give each its own `Hardware` (and `IRobot` and
+// state machine), and select its hardware before running it. Robots on
+// different threads are independent; each thread starts with its own default
+// hardware selected.
+namespace sim
+{
+    // Approximate blocking time of the real drivers, in microseconds.
+    unsigned long const LINE_SENSOR_TIMEOUT_US = 2000;
+    unsigned long const PROXIMITY_READ_US = 3000;
+    unsigned long const LCD_CLEAR_US = 1600;
+    unsigned long const LCD_CHAR_US = 45;
+    unsigned long const MOTOR_WRITE_US = 4;
+
+    // I2C addresses (SA0 high, as on the Zumo 32U4) of the LSM303D
+    // accelerometer and the L3GD20H gyro, and the depth of their FIFOs.
+    uint8_t const LSM303D_ADDRESS = 0x1D;
+    uint8_t const L3GD20H_ADDRESS = 0x6B;
+    uint8_t const IMU_FIFO_SIZE = 32;
+
+    // An ST inertial sensor on the I2C bus: the LSM303D accelerometer or the
+    // L3GD20H gyro, which have the same FIFO and output registers. While
+    // virtual time advances, a sample is taken at each tick of the output
+    // data rate set in CTRL1: `value`, or what `source` gives for the
+    // sample's time if it is set.
+    //
+    // With the FIFO enabled (FIFO_EN, and stream mode in FIFO_CTRL), samples
+    // queue in `fifo`, dropping the oldest when it is full, and
+    // auto-incrementing reads of the output registers take the oldest
+    // sample, rolling over from OUT_Z_H to OUT_X_L and the next sample.
+    // Otherwise the output registers hold the latest sample.
+    struct Imu
+    {
+        Imu();
+
+        int16_t value[3];
+        std::function<void(unsigned long t_us, int16_t * xyz)> source;
+        uint8_t registers[0x40];
+        uint8_t pointer;
+        int16_t output[3];
+        int16_t fifo[IMU_FIFO_SIZE][3];
+        uint8_t fifo_level;
+        bool overrun;
+        unsigned long next_us;
+        unsigned long samples;
+    };
+
+    struct Hardware
+    {
+        Hardware();
+
+        // Virtual clock.
+        unsigned long clock_us;
+
+        // Button B (start button) level. `true` => pressed.
+        bool start_button;
+
+        // Reflectance readings for the five line sensors, left to right.
+        // Low => white (ring boundary). High => black (ring).
+        unsigned int line[5];
+
+        // Virtual time the last line sensor read completed.
+        unsigned long line_read_us;
+
+        // Proximity brightness counts (0 through 6).
+        uint8_t proximity_front_left;
+        uint8_t proximity_front_right;
+        uint8_t proximity_left;
+        uint8_t proximity_right;
+
+        // Encoder counts since last reset.
+        int16_t encoder_left;
+        int16_t encoder_right;
+
+        // Wheel model. While virtual time advances, the encoders count at
+        // `counts_per_speed_s` counts per second per unit of motor speed.
+        // The default approximates a 75:1 Zumo (about 5000 counts/s at full
+        // speed). Set to 0 to drive the encoders directly.
+        double counts_per_speed_s;
+        double travel_left;
+        double travel_right;
+
+        // Motor response. Commands up to `motor_deadband` in magnitude do not
+        // turn the wheel, and the rest of the range drives it up to full
+        // speed. `motor_droop` bends the response: full speed is reached
+        // either way, but at half speed the wheel turns `motor_droop / 4` of
+        // full speed slower than a linear motor. Each wheel's speed is scaled
+        // by its gain, and follows its command with a first order lag of
+        // `motor_time_constant_s`. The defaults are an ideal linear motor.
+        double motor_deadband;
+        double motor_droop;
+        double motor_gain_left;
+        double motor_gain_right;
+        double motor_time_constant_s;
+
+        // Current wheel speeds, in motor speed units.
+        double wheel_speed_left;
+        double wheel_speed_right;
+
+        // Counts moved by the wheel model since start up, unaffected by
+        // encoder resets.
+        long odometer_left;
+        long odometer_right;
+
+        // Last commanded motor speeds, and number of hardware writes.
+        int16_t motor_left;
+        int16_t motor_right;
+        unsigned long motor_writes;
+        unsigned long motor_write_us;
+
+        // I2C bus clock, from `Wire.setClock()`. Each byte on the bus,
+        // address bytes included, takes nine bit times.
+        unsigned long i2c_clock_hz;
+        unsigned long i2c_bytes;
+
+        // LSM303D accelerometer. Readings are raw counts (4096 per g at
+        // +/-8 g full scale).
+        Imu accelerometer;
+
+        // L3GD20H gyro. Readings are raw counts (70 thousandths of a degree
+        // per second at +/-2000 degrees per second full scale). Unless its
+        // `source` is set, its z axis reads the yaw model's rate plus
+        // `gyro_bias`.
+        Imu gyro;
+        int16_t gyro_bias;
+
+        // Yaw model, with the wheel model. The robot turns
+        // `degrees_per_count` for each count the wheels turn in opposite
+        // directions, less the fraction `tread_slip` lost to the treads
+        // slipping. The default matches the 88 mm track and 7.5 counts per mm
+        // of the wheel model's 75:1 Zumo, with no slip. `yaw_rate` (degrees
+        // per second) and `heading` (degrees since start up) are the robot's
+        // true turn, counterclockwise.
+        double degrees_per_count;
+        double tread_slip;
+        double yaw_rate;
+        double heading;
+
+        // LCD contents (two lines of eight characters), and number of
+        // characters written.
+        char lcd[2][9];
+        uint8_t lcd_x;
+        uint8_t lcd_y;
+        unsigned long lcd_writes;
+    };
+
+    // Hardware used by the mock drivers on the calling thread.
+    Hardware & hardware();
+    void select(Hardware & hw);
+
+    // I2C transfers on the selected hardware's bus, for the mock Wire and IMU
+    // drivers. A write is a register address, then any values to write from
+    // it; a read continues from the last address written. Both charge the
+    // bus time, and return `false` (a write) or 0 bytes (a read) if no
+    // device answers at `address`.
+    bool i2c_write(uint8_t address, uint8_t const * data, uint8_t length);
+    uint8_t i2c_read(uint8_t address, uint8_t * data, uint8_t length);
+
+    // Virtual clock of the selected hardware. Advancing it moves its wheels
+    // and samples its accelerometer and gyro.
+    unsigned long now_us();
+    void set_now_us(unsigned long t);
+    void advance_us(unsigned long us);
+
+    // Linear congruential generator for the host tools' synthetic inputs:
+    // steps `seed`, and returns its top 16 bits. Repeatable for a given
+    // seed on every host.
+    uint32_t next(uint32_t & seed);
+
+    // Uniform in [`low`, `high`), from `next()`.
+    double uniform(uint32_t & seed, double low, double high);
+
+    // Noisy scenario shared by the host tools, for pass `loop` of the
+    // sketch's `loop()`: start pressed on passes 10 to 19, then a black ring
+    // crossed now and then, and a noisy opponent. Sets `hw`'s start button,
+    // line sensors and front proximity counts from `seed`.
+    void step_noisy(Hardware & hw, unsigned long loop, uint32_t & seed);
+}
@@ -0,0 +1,274 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// Wheel speed control benchmark.
+//
+// Drives an `IRobot` against a simulated motor with a deadband, a bent
+// response, mismatched wheels and a first order lag, and reports the step
+// response of each wheel: rise time (10% to 90% of the requested speed) and
+// steady state error (mean over the last half second). Runs open loop, with
+// speed control on the default (linear) calibration, and with speed control
+// on a calibration measured by `IRobot::calibrate_motors()`, then on the
+// default calibration again with the speeds re-commanded every loop, as a
+// state that calls `move()` on every event would.
+//
+// Errors are against wheel speeds where a requested speed of 400 is the full
+// speed of the slower wheel, which is what the calibrated controller targets.
+// The default table assumes a 5000 counts per second wheel, so the controller
+// holds both wheels about 11% faster than that on it. Rise times of wheels
+// that never reach 90% of the requested speed are shown as "-".
+//
+// Then checks that `set_motor_calibration()` refuses a table that stops
+// rising, and exits nonzero if it does not.
+//
+// Usage: speedbench
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "robot.h"
+#include "sim.h"
+
+double const STEP_S = 1.0;
+double const SETTLE_S = 0.5;
+
+enum Mode
+{
+    OPEN_LOOP,
+    DEFAULT_CALIBRATION,
+    CALIBRATED,
+    REPEATED,
+    MODE_COUNT
+};
+
+static char const * const mode_names[MODE_COUNT] =
+{
+    "open loop",
+    "closed loop, default table",
+    "closed loop, calibrated",
+    "closed loop, default table, move() every loop"
+};
+
+struct Step
+{
+    int16_t left;
+    int16_t right;
+};
+
+struct WheelResponse
+{
+    double rise_ms;
+    double error_pct;
+};
+
+static char const * format_rise(WheelResponse const & r, char * buffer)
+{
+    if (r.rise_ms < 0)
+    {
+        return "-";
+    }
+    sprintf(buffer, "%.0f", r.rise_ms);
+    return buffer;
+}
+
+static void set_motor_model(sim::Hardware & hw)
+{
+    hw.motor_deadband = 40;
+    hw.motor_droop = 0.3;
+    hw.motor_gain_left = 1.0;
+    hw.motor_gain_right = 0.9;
+    hw.motor_time_constant_s = 0.06;
+}
+
+// Run the event loop until `t_us`, discarding events, calling `sample()`
+// after every pass.
+template <typename F>
+static void run_until(IRobot & robot, unsigned long t_us, F sample)
+{
+    while (sim::now_us() < t_us)
+    {
+        robot.generate_events();
+        while (robot.events().front())
+        {
+            robot.events().pop();
+        }
+        robot.commit_motors();
+        robot.update_display();
+        sample();
+    }
+}
+
+// Rise time and steady state error of one wheel, from speeds `speeds` (counts
+// per second) sampled at `times` (seconds from the step), against `target`.
+static WheelResponse response(
+    std::vector<double> const & times,
+    std::vector<double> const & speeds,
+    double target
+)
+{
+    WheelResponse r = {-1.0, 0.0};
+    double t10 = -1.0;
+    double sum = 0.0;
+    unsigned int n = 0;
+
+    for (size_t i = 0; i < times.size(); ++i)
+    {
+        double const fraction = speeds[i] / target;
+        if (t10 < 0 && fraction >= 0.1)
+        {
+            t10 = times[i];
+        }
+        if (r.rise_ms < 0 && fraction >= 0.9)
+        {
+            r.rise_ms = (times[i] - t10) * 1000;
+        }
+        if (times[i] >= STEP_S - 0.5)
+        {
+            sum += speeds[i];
+            ++n;
+        }
+    }
+    r.error_pct = n ? 100.0 * (sum / n - target) / target : 0.0;
+
+    return r;
+}
+
+int main()
+{
+    Step const steps[] = {{100, 100}, {200, 200}, {300, 300}, {100, 300}};
+    sim::Hardware hw;
+    set_motor_model(hw);
+    sim::select(hw);
+
+    // Full speed of the slower wheel, in counts per second.
+    double const top = hw.counts_per_speed_s * 400 *
+        (hw.motor_gain_left < hw.motor_gain_right ?
+            hw.motor_gain_left : hw.motor_gain_right);
+
+    printf(
+        "motor: deadband %.0f, droop %.1f, gains %.2f/%.2f, lag %.0f ms\n",
+        hw.motor_deadband,
+        hw.motor_droop,
+        hw.motor_gain_left,
+        hw.motor_gain_right,
+        hw.motor_time_constant_s * 1000
+    );
+
+    MotorCalibration calibration;
+    for (unsigned int mode = 0; mode < MODE_COUNT; ++mode)
+    {
+        IRobot robot;
+        robot.setup();
+        if (mode == DEFAULT_CALIBRATION || mode == REPEATED)
+        {
+            robot.set_speed_control(true);
+        }
+        else if (mode == CALIBRATED)
+        {
+            robot.calibrate_motors();
+            calibration = robot.motor_calibration();
+        }
+
+        printf("\n%s\n", mode_names[mode]);
+        printf(
+            "%11s   %8s %8s   %8s %8s\n",
+            "speed",
+            "rise ms",
+            "",
+            "error %",
+            ""
+        );
+        printf(
+            "%11s   %8s %8s   %8s %8s\n",
+            "left/right",
+            "left",
+            "right",
+            "left",
+            "right"
+        );
+        for (Step const & step : steps)
+        {
+            robot.stop();
+            run_until(robot, sim::now_us() + SETTLE_S * 1e6, []() {});
+
+            std::vector<double> times;
+            std::vector<double> left;
+            std::vector<double> right;
+            unsigned long const start_us = sim::now_us();
+            robot.move(step.left, step.right);
+            robot.commit_motors();
+            run_until(
+                robot,
+                start_us + STEP_S * 1e6,
+                [&]()
+                {
+                    if (mode == REPEATED)
+                    {
+                        robot.move(step.left, step.right);
+                    }
+                    times.push_back((sim::now_us() - start_us) / 1e6);
+                    left.push_back(
+                        hw.wheel_speed_left * hw.counts_per_speed_s
+                    );
+                    right.push_back(
+                        hw.wheel_speed_right * hw.counts_per_speed_s
+                    );
+                }
+            );
+
+            WheelResponse const l =
+                response(times, left, step.left * top / 400);
+            WheelResponse const r =
+                response(times, right, step.right * top / 400);
+            char left_rise[16];
+            char right_rise[16];
+            printf(
+                "%5d/%-5d   %8s %8s   %+8.1f %+8.1f\n",
+                step.left,
+                step.right,
+                format_rise(l, left_rise),
+                format_rise(r, right_rise),
+                l.error_pct,
+                r.error_pct
+            );
+        }
+        robot.stop();
+        robot.commit_motors();
+    }
+
+    printf("\ncalibration (counts/s at command):\n%8s", "");
+    for (uint8_t i = 0; i < MotorCalibration::POINTS; ++i)
+    {
+        printf(" %5d", i * MotorCalibration::STEP);
+    }
+    printf("\n%-8s", "left");
+    for (int16_t rate : calibration.left)
+    {
+        printf(" %5d", rate);
+    }
+    printf("\n%-8s", "right");
+    for (int16_t rate : calibration.right)
+    {
+        printf(" %5d", rate);
+    }
+    printf("\n");
+
+    // Leave a step flat, which would divide by zero in the command lookup.
+    MotorCalibration flat = calibration;
+    flat.right[4] = flat.right[3];
+    IRobot robot;
+    robot.setup();
+    bool const refused =
+        !robot.set_motor_calibration(flat) &&
+        robot.set_motor_calibration(calibration);
+    printf(
+        "flat calibration step: %s\n",
+        refused ? "refused" : "FAILED, accepted"
+    );
+
+    return refused ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// Encoder target overshoot benchmark.
+//
+// Spins the robot with `IRobot::spin_left()` at several speeds and angles
+// against the simulated wheel model, running the sketch's event loop until
+// the encoder event is generated, and reports how far past the target the
+// wheels had turned by then. Spins are by encoder counts; see turnbench for
+// spins by the gyro heading.
+//
+// Then checks that a target does not complete early when its wheel reverses
+// partway, and exits nonzero if it does.
+//
+// Usage: spinbench [spins per case]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "encodertargets.h"
+#include "eventqueue.h"
+#include "robot.h"
+#include "robotstatemachine.h"
+#include "sim.h"
+
+// Defined in sumobot-template.ino.
+extern IRobot robot;
+extern RobotStateMachine machine;
+void setup();
+
+// Drive `wheels` 200 counts forward then 150 back, in 10 count checks, on
+// a 300 count target. Returns whether the target completed.
+static bool reversal_completes(uint8_t wheels)
+{
+    EncoderTargets<1> targets;
+    bool completed = false;
+    int32_t left = 1000;
+    int32_t right = -1000;
+    targets.start(0, wheels, 300, left, right);
+
+    for (int i = 0; i < 35 && !completed; ++i)
+    {
+        int32_t const step = i < 20 ? 10 : -10;
+        left += wheels & LEFT_WHEEL ? step : 0;
+        right += wheels & RIGHT_WHEEL ? step : 0;
+        targets.check(left, right, [&](uint8_t) { completed = true; });
+    }
+    return completed;
+}
+
+// Encoder counts per degree of rotation used by IRobot (50:1 gearing).
+int const counts_per_degree = 4;
+
+int main(int argc, char ** argv)
+{
+    unsigned int const spins = argc > 1 ? strtoul(argv[1], nullptr, 0) : 50;
+    int16_t const speeds[] = {100, 200, 400};
+    int16_t const angles[] = {30, 90, 180};
+    sim::Hardware & hw = sim::hardware();
+
+    setup();
+    robot.set_gyro_spins(false);
+
+    printf("spin_left() overshoot at encoder event (counts, mean of both wheels)\n");
+    printf("%6s %6s %8s %8s %8s %8s\n", "speed", "deg", "target", "mean", "min", "max");
+    for (int16_t speed : speeds)
+    {
+        for (int16_t angle : angles)
+        {
+            int const target = angle * counts_per_degree;
+            long sum = 0;
+            int min = 0x7FFF;
+            int max = -0x7FFF;
+
+            for (unsigned int i = 0; i < spins; ++i)
+            {
+                // Vary the phase of the spin against the sensor schedule.
+                sim::advance_us(137 * i % 5000);
+                long const left_start = hw.odometer_left;
+                long const right_start = hw.odometer_right;
+
+                robot.spin_left(angle, speed);
+                robot.commit_motors();
+                bool done = false;
+                while (!done)
+                {
+                    robot.generate_events();
+                    while (RobotEventSlot * slot = robot.events().front())
+                    {
+                        done = done || slot->kind() == ENCODER_EVENT;
+                        machine.handle_event(slot->event());
+                        robot.events().pop();
+                    }
+                    robot.commit_motors();
+                    sim::advance_us(50);
+                }
+                robot.stop();
+                robot.commit_motors();
+
+                int const turned = (
+                    labs(hw.odometer_left - left_start) +
+                    labs(hw.odometer_right - right_start)
+                ) / 2;
+                int const overshoot = turned - target;
+                sum += overshoot;
+                min = overshoot < min ? overshoot : min;
+                max = overshoot > max ? overshoot : max;
+            }
+
+            printf(
+                "%6d %6d %8d %8.1f %8d %8d\n",
+                speed,
+                angle,
+                target,
+                static_cast<double>(sum) / spins,
+                min,
+                max
+            );
+        }
+    }
+
+    bool const reversal =
+        reversal_completes(LEFT_WHEEL) || reversal_completes(BOTH_WHEELS);
+    printf(
+        "wheel reversal mid-target: %s\n",
+        reversal ? "FAILED, early encoder event" : "no early encoder event"
+    );
+
+    return reversal ? 1 : 0;
+}
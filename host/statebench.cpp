@@ -0,0 +1,277 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// State machine library benchmark.
+//
+// Builds synthetic state hierarchies and times the library's hot paths
+// against hierarchy depth and width, independent of the robot.
+//
+// Usage: statebench [iterations]
+
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "statemachine.h"
+
+using namespace statemachine;
+
+typedef std::chrono::steady_clock Clock;
+
+class BenchState : public State
+{
+public:
+    BenchState(State * parent, bool handles) :
+        State("bench", parent), m_handles(handles)
+    {}
+
+    using State::active_state;
+    using State::find_common_parent;
+
+protected:
+    bool on_event(Event & event) override
+    {
+        return m_handles;
+    }
+
+private:
+    bool m_handles;
+};
+
+// Root of a bench machine, with storage for the state table and active leaf.
+class BenchRoot : public BenchState
+{
+public:
+    BenchRoot() : BenchState(nullptr, true), m_table() {}
+
+protected:
+    Table * table() override
+    {
+        return &m_table;
+    }
+
+private:
+    Table m_table;
+};
+
+// A single chain of `depth` states below the root. The root handles events,
+// and so does the leaf if `leaf_handles`: with it, dispatch stops at the
+// leaf; without it, every dispatch bubbles up the whole chain.
+class Chain
+{
+public:
+    Chain(unsigned int depth, bool leaf_handles)
+    {
+        m_states.emplace_back(new BenchRoot());
+        for (unsigned int i = 0; i < depth; ++i)
+        {
+            bool const leaf = i + 1 == depth;
+            m_states.emplace_back(
+                new BenchState(m_states.back().get(), leaf && leaf_handles)
+            );
+        }
+        root().transition_to_state(leaf());
+    }
+
+    BenchState & root() { return *m_states.front(); }
+    BenchState & leaf() { return *m_states.back(); }
+
+private:
+    std::vector<std::unique_ptr<BenchState>> m_states;
+};
+
+// `width` chains of `depth` states below the root. Transitions between
+// leaves of different chains exit and enter `depth` states each, through the
+// root.
+class Comb
+{
+public:
+    enum Mode
+    {
+        UNFROZEN,
+        FROZEN,
+        FROZEN_WITH_TABLE
+    };
+
+    Comb(unsigned int width, unsigned int depth, Mode mode)
+    {
+        m_states.emplace_back(new BenchRoot());
+        for (unsigned int w = 0; w < width; ++w)
+        {
+            BenchState * parent = m_states.front().get();
+            for (unsigned int d = 0; d < depth; ++d)
+            {
+                m_states.emplace_back(new BenchState(parent, false));
+                parent = m_states.back().get();
+            }
+            m_leaves.push_back(parent);
+        }
+
+        for (auto & state : m_states)
+        {
+            m_table.push_back(state.get());
+        }
+        if (mode != UNFROZEN)
+        {
+            if (mode == FROZEN_WITH_TABLE)
+            {
+                m_lca.resize(m_table.size() * m_table.size());
+            }
+            root().freeze(
+                m_table.data(),
+                static_cast<uint8_t>(m_table.size()),
+                m_lca.empty() ? nullptr : m_lca.data()
+            );
+        }
+        root().transition_to_state(*m_leaves.front());
+    }
+
+    BenchState & root() { return *m_states.front(); }
+    BenchState & state(size_t i) { return *m_states[i]; }
+    size_t size() const { return m_states.size(); }
+    State & leaf(size_t i) { return *m_leaves[i % m_leaves.size()]; }
+
+private:
+    std::vector<std::unique_ptr<BenchState>> m_states;
+    std::vector<State *> m_table;
+    std::vector<uint8_t> m_lca;
+    std::vector<State *> m_leaves;
+};
+
+// Frozen lookups must agree with the unfrozen search for every pair.
+static bool check_common_parents(unsigned int width, unsigned int depth)
+{
+    Comb unfrozen(width, depth, Comb::UNFROZEN);
+    Comb frozen(width, depth, Comb::FROZEN);
+    Comb table(width, depth, Comb::FROZEN_WITH_TABLE);
+
+    for (size_t i = 0; i < unfrozen.size(); ++i)
+    {
+        for (size_t j = 0; j < unfrozen.size(); ++j)
+        {
+            State * expected =
+                unfrozen.state(i).find_common_parent(&unfrozen.state(j));
+            State * expected_frozen = nullptr;
+            State * expected_table = nullptr;
+            for (size_t k = 0; expected && k < unfrozen.size(); ++k)
+            {
+                if (&unfrozen.state(k) == expected)
+                {
+                    expected_frozen = &frozen.state(k);
+                    expected_table = &table.state(k);
+                }
+            }
+
+            if (
+                frozen.state(i).find_common_parent(&frozen.state(j)) !=
+                    expected_frozen ||
+                table.state(i).find_common_parent(&table.state(j)) !=
+                    expected_table
+            )
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static double ns_per_op(Clock::time_point start, unsigned long ops)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count()
+        / ops;
+}
+
+int main(int argc, char ** argv)
+{
+    unsigned long const iterations =
+        argc > 1 ? strtoul(argv[1], nullptr, 0) : 2000000;
+    unsigned int const depths[] = {1, 2, 4, 8, 16, 32};
+    Event event(0, "bench");
+
+    printf("Dispatch cost vs. hierarchy depth (ns per call)\n");
+    printf(
+        "%6s %14s %14s %14s\n",
+        "depth", "leaf handles", "root handles", "active_state"
+    );
+    for (unsigned int depth : depths)
+    {
+        Chain leaf_handles(depth, true);
+        Chain root_handles(depth, false);
+
+        Clock::time_point start = Clock::now();
+        for (unsigned long i = 0; i < iterations; ++i)
+        {
+            leaf_handles.root().handle_event(event);
+        }
+        double const leaf_ns = ns_per_op(start, iterations);
+
+        start = Clock::now();
+        for (unsigned long i = 0; i < iterations; ++i)
+        {
+            root_handles.root().handle_event(event);
+        }
+        double const root_ns = ns_per_op(start, iterations);
+
+        State * volatile sink = nullptr;
+        start = Clock::now();
+        for (unsigned long i = 0; i < iterations; ++i)
+        {
+            sink = leaf_handles.leaf().active_state();
+        }
+        double const active_ns = ns_per_op(start, iterations);
+        (void)sink;
+
+        printf("%6u %14.2f %14.2f %14.2f\n", depth, leaf_ns, root_ns, active_ns);
+    }
+
+    unsigned int const widths[] = {2, 4, 8};
+    unsigned int const comb_depths[] = {2, 4, 8, 16, 30};
+    unsigned long const transitions = iterations / 8;
+
+    printf("\nLeaf-to-leaf transition cost vs. width and depth (ns per call)\n");
+    printf(
+        "%6s %6s %7s %14s %14s %14s\n",
+        "width", "depth", "states", "unfrozen", "frozen", "frozen+table"
+    );
+    for (unsigned int width : widths)
+    {
+        for (unsigned int depth : comb_depths)
+        {
+            if (!check_common_parents(width, depth))
+            {
+                fprintf(
+                    stderr,
+                    "common parent mismatch at width %u, depth %u\n",
+                    width,
+                    depth
+                );
+                return 1;
+            }
+
+            printf("%6u %6u %7u", width, depth, 1 + width * depth);
+            Comb::Mode const modes[] = {
+                Comb::UNFROZEN, Comb::FROZEN, Comb::FROZEN_WITH_TABLE
+            };
+            for (Comb::Mode mode : modes)
+            {
+                Comb comb(width, depth, mode);
+                Clock::time_point const start = Clock::now();
+                for (unsigned long i = 1; i <= transitions; ++i)
+                {
+                    comb.root().transition_to_state(comb.leaf(i));
+                }
+                printf(" %14.2f", ns_per_op(start, transitions));
+            }
+            printf("\n");
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,527 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// Detection parameter sweep.
+//
+// Evaluates `RobotConfig` settings in the simulated ring of arena.h, through
+// `IRobot::generate_events()`, and reports the Pareto front of reaction
+// latency against false positive rate.
+//
+// For each setting:
+//   - boundary latency: the robot drives at the border from random poses at
+//     `max_speed`. Time from a line sensor reaching the border to the first
+//     boundary event.
+//   - proximity latency: an opponent approaches the parked robot from random
+//     bearings at 300 mm/s. Time from entering sensor range to the first
+//     proximity detection event.
+//   - false positives: boundary and proximity detections per minute with the
+//     robot parked in the centre of an empty ring.
+// Reaction latency is the sum of the two mean latencies. Settings that missed
+// any boundary or opponent are left off the front.
+//
+// `encoder_counts_per_degree` only affects spins, so it is swept on its own,
+// reporting the error of a 90 degree `spin_left()` at each speed.
+//
+// Settings are split across worker threads, one per core. Each thread drives
+// its own robot on its own default `Hardware`.
+//
+// Usage:
+//   sweep [workers]                       grid search
+//   sweep random N [seed] [workers]       N random settings
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "arena.h"
+#include "eventqueue.h"
+#include "robot.h"
+#include "sim.h"
+
+// The robot under test on this thread.
+static thread_local IRobot robot;
+
+typedef std::chrono::steady_clock Clock;
+
+unsigned int const BOUNDARY_TRIALS = 30;
+unsigned int const PROXIMITY_TRIALS = 30;
+double const PARKED_S = 300.0;
+double const STEP_S = 0.001;
+double const APPROACH_MM_PER_S = 300.0;
+
+struct Metrics
+{
+    double boundary_ms;
+    double proximity_ms;
+    unsigned int boundary_missed;
+    unsigned int proximity_missed;
+    double boundary_fp_per_min;
+    double proximity_fp_per_min;
+};
+
+struct Setting
+{
+    RobotConfig config;
+    Metrics metrics;
+};
+
+// Detections generated by one pass.
+struct Detections
+{
+    bool boundary;
+    bool proximity;
+    bool encoder;
+};
+
+// One pass of sensing and event generation, then move the arena up to the
+// time it took.
+static Detections pass(sim::Arena & arena, uint32_t & seed, double & t)
+{
+    sim::Hardware & hw = sim::hardware();
+    Detections d = {false, false, false};
+
+    sim::Arena::sense(arena.robot, arena.opponent, hw, seed);
+    robot.generate_events();
+    while (RobotEventSlot * slot = robot.events().front())
+    {
+        Event & e = slot->event();
+        switch (slot->kind())
+        {
+        case BOUNDARY_EVENT:
+            d.boundary |= static_cast<BoundaryEvent &>(e).m_direction != NONE;
+            break;
+        case PROXIMITY_EVENT:
+            d.proximity |=
+                static_cast<ProximityEvent &>(e).m_direction != NONE;
+            break;
+        case ENCODER_EVENT:
+            d.encoder = true;
+            break;
+        default:
+            break;
+        }
+        robot.events().pop();
+    }
+    robot.commit_motors();
+
+    arena.robot.motor_left = hw.motor_left;
+    arena.robot.motor_right = hw.motor_right;
+    double const now = sim::now_us() / 1e6;
+    while (t < now)
+    {
+        arena.step(STEP_S);
+        t += STEP_S;
+    }
+
+    return d;
+}
+
+// Power up with `config`, and the sketch's event policies, with the opponent
+// far outside sensor range.
+static sim::Arena start(RobotConfig const & config, double & t)
+{
+    sim::Hardware & hw = sim::hardware();
+    hw = sim::Hardware();
+    sim::set_now_us(0);
+    robot.setup();
+    robot.set_event_policy(BOUNDARY_EVENT, EDGE);
+    robot.set_event_policy(PROXIMITY_EVENT, EDGE);
+    robot.set_config(config);
+    while (robot.events().front())
+    {
+        robot.events().pop();
+    }
+
+    sim::Arena arena;
+    arena.robot = sim::Body{0, 0, 0, 0, 0};
+    arena.opponent = sim::Body{5000, 5000, 0, 0, 0};
+    t = sim::now_us() / 1e6;
+    return arena;
+}
+
+static bool line_over_border(sim::Body const & body)
+{
+    for (unsigned int i = 0; i < 5; i += 2)
+    {
+        double x;
+        double y;
+        sim::Arena::line_sensor_position(body, i, x, y);
+        if (hypot(x, y) > sim::RING_RADIUS_MM - sim::BORDER_MM)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void measure_boundary(
+    RobotConfig const & config,
+    uint32_t & seed,
+    Metrics & m
+)
+{
+    double sum_s = 0;
+    unsigned int hits = 0;
+
+    for (unsigned int i = 0; i < BOUNDARY_TRIALS; ++i)
+    {
+        double t;
+        sim::Arena arena = start(config, t);
+        double const angle = sim::uniform(seed, -M_PI, M_PI);
+        arena.robot.x = 200 * cos(angle);
+        arena.robot.y = 200 * sin(angle);
+        arena.robot.heading = angle + sim::uniform(seed, -0.8, 0.8);
+        robot.move(400);
+        robot.commit_motors();
+
+        double cross_s = -1;
+        while (!sim::Arena::out(arena.robot))
+        {
+            if (cross_s < 0 && line_over_border(arena.robot))
+            {
+                cross_s = t;
+            }
+            if (pass(arena, seed, t).boundary && cross_s >= 0)
+            {
+                sum_s += t - cross_s;
+                ++hits;
+                break;
+            }
+        }
+    }
+
+    m.boundary_missed = BOUNDARY_TRIALS - hits;
+    m.boundary_ms = hits ? 1000 * sum_s / hits : 0;
+}
+
+static void measure_proximity(
+    RobotConfig const & config,
+    uint32_t & seed,
+    Metrics & m
+)
+{
+    double sum_s = 0;
+    unsigned int hits = 0;
+    int16_t const speed = static_cast<int16_t>(
+        APPROACH_MM_PER_S / sim::MM_PER_S_PER_SPEED
+    );
+
+    for (unsigned int i = 0; i < PROXIMITY_TRIALS; ++i)
+    {
+        double t;
+        sim::Arena arena = start(config, t);
+        double const b = sim::uniform(seed, -0.4, 0.4);
+        arena.opponent = sim::Body{
+            600 * cos(b),
+            600 * sin(b),
+            b + M_PI,
+            speed,
+            speed
+        };
+
+        double in_range_s = -1;
+        while (sim::Arena::gap(arena.robot, arena.opponent) > 0)
+        {
+            if (
+                in_range_s < 0 &&
+                sim::Arena::gap(arena.robot, arena.opponent) <
+                    sim::PROXIMITY_RANGE_MM
+            )
+            {
+                in_range_s = t;
+            }
+            if (pass(arena, seed, t).proximity && in_range_s >= 0)
+            {
+                sum_s += t - in_range_s;
+                ++hits;
+                break;
+            }
+        }
+    }
+
+    m.proximity_missed = PROXIMITY_TRIALS - hits;
+    m.proximity_ms = hits ? 1000 * sum_s / hits : 0;
+}
+
+static void measure_false_positives(
+    RobotConfig const & config,
+    uint32_t & seed,
+    Metrics & m
+)
+{
+    double t;
+    sim::Arena arena = start(config, t);
+    double const end_s = t + PARKED_S;
+    unsigned long boundary = 0;
+    unsigned long proximity = 0;
+
+    while (t < end_s)
+    {
+        Detections const d = pass(arena, seed, t);
+        boundary += d.boundary;
+        proximity += d.proximity;
+    }
+
+    m.boundary_fp_per_min = boundary * 60.0 / PARKED_S;
+    m.proximity_fp_per_min = proximity * 60.0 / PARKED_S;
+}
+
+static Metrics evaluate(RobotConfig const & config, uint32_t seed)
+{
+    Metrics m;
+    measure_boundary(config, seed, m);
+    measure_proximity(config, seed, m);
+    measure_false_positives(config, seed, m);
+    return m;
+}
+
+// Heading error of a 90 degree spin_left() at `speed`, in degrees.
+static double spin_error(int16_t counts_per_degree, int16_t speed)
+{
+    RobotConfig config;
+    config.encoder_counts_per_degree = counts_per_degree;
+    uint32_t seed = 1;
+    double t;
+    sim::Arena arena = start(config, t);
+
+    // Spin by encoder counts, since that is what the setting is for.
+    robot.set_gyro_spins(false);
+    robot.spin_left(90, speed);
+    robot.commit_motors();
+    while (!pass(arena, seed, t).encoder)
+    {
+    }
+    robot.stop();
+    robot.commit_motors();
+
+    return arena.robot.heading * 180 / M_PI - 90;
+}
+
+static double latency(Metrics const & m)
+{
+    return m.boundary_ms + m.proximity_ms;
+}
+
+static double false_positives(Metrics const & m)
+{
+    return m.boundary_fp_per_min + m.proximity_fp_per_min;
+}
+
+// Evaluate the settings from `first`, every `workers`th.
+static void run_worker(
+    std::vector<Setting> & settings,
+    size_t first,
+    unsigned int workers
+)
+{
+    for (size_t i = first; i < settings.size(); i += workers)
+    {
+        settings[i].metrics = evaluate(settings[i].config, i + 1);
+    }
+}
+
+// Evaluate `settings` across `workers` threads.
+static void run(std::vector<Setting> & settings, unsigned int workers)
+{
+    std::vector<std::thread> threads;
+    for (unsigned int w = 0; w < workers; ++w)
+    {
+        threads.push_back(
+            std::thread(run_worker, std::ref(settings), w, workers)
+        );
+    }
+    for (std::thread & t : threads)
+    {
+        t.join();
+    }
+}
+
+static void print_setting(Setting const & s)
+{
+    Metrics const & m = s.metrics;
+    printf(
+        "  %9u %9u %9d   %8.1f %8.1f %8.1f   %7.1f %7.1f %7.1f   %u/%u\n",
+        s.config.boundary_threshold,
+        s.config.proximity_threshold,
+        s.config.max_speed,
+        latency(m),
+        m.boundary_ms,
+        m.proximity_ms,
+        false_positives(m),
+        m.boundary_fp_per_min,
+        m.proximity_fp_per_min,
+        m.boundary_missed,
+        m.proximity_missed
+    );
+}
+
+static void print_header()
+{
+    printf(
+        "  %9s %9s %9s   %8s %8s %8s   %7s %7s %7s   %s\n",
+        "boundary",
+        "proximity",
+        "max",
+        "latency",
+        "boundary",
+        "prox",
+        "FP/min",
+        "boundary",
+        "prox",
+        "missed"
+    );
+    printf(
+        "  %9s %9s %9s   %8s %8s %8s\n",
+        "threshold",
+        "threshold",
+        "speed",
+        "ms",
+        "ms",
+        "ms"
+    );
+}
+
+int main(int argc, char ** argv)
+{
+    long const cores = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int workers = cores > 0 ? cores : 1;
+    std::vector<Setting> settings;
+
+    if (argc >= 3 && strcmp(argv[1], "random") == 0)
+    {
+        unsigned long const n = strtoul(argv[2], nullptr, 0);
+        uint32_t seed = argc > 3 ? strtoul(argv[3], nullptr, 0) : 1;
+        if (argc > 4)
+        {
+            workers = strtoul(argv[4], nullptr, 0);
+        }
+        for (unsigned long i = 0; i < n; ++i)
+        {
+            Setting s;
+            s.config.boundary_threshold = 100 + sim::next(seed) % 1300;
+            s.config.proximity_threshold = 1 + sim::next(seed) % 4;
+            s.config.max_speed = 150 + sim::next(seed) % 251;
+            settings.push_back(s);
+        }
+    }
+    else
+    {
+        if (argc > 1)
+        {
+            workers = strtoul(argv[1], nullptr, 0);
+        }
+        uint16_t const boundary[] = {150, 250, 400, 600, 800, 1000, 1200};
+        uint8_t const proximity[] = {1, 2, 3, 4};
+        int16_t const speed[] = {200, 300, 400};
+        for (uint16_t b : boundary)
+        {
+            for (uint8_t p : proximity)
+            {
+                for (int16_t v : speed)
+                {
+                    Setting s;
+                    s.config.boundary_threshold = b;
+                    s.config.proximity_threshold = p;
+                    s.config.max_speed = v;
+                    settings.push_back(s);
+                }
+            }
+        }
+    }
+
+    // The compiled-in defaults, for reference.
+    settings.push_back(Setting());
+
+    Clock::time_point const begin = Clock::now();
+    run(settings, workers ? workers : 1);
+    double const seconds =
+        std::chrono::duration<double>(Clock::now() - begin).count();
+
+    Setting const defaults = settings.back();
+    settings.pop_back();
+
+    // Pareto front over settings that never missed.
+    std::vector<Setting> front;
+    for (Setting const & s : settings)
+    {
+        if (s.metrics.boundary_missed || s.metrics.proximity_missed)
+        {
+            continue;
+        }
+        bool dominated = false;
+        for (Setting const & o : settings)
+        {
+            if (o.metrics.boundary_missed || o.metrics.proximity_missed)
+            {
+                continue;
+            }
+            double const ol = latency(o.metrics);
+            double const of = false_positives(o.metrics);
+            double const sl = latency(s.metrics);
+            double const sf = false_positives(s.metrics);
+            if (ol <= sl && of <= sf && (ol < sl || of < sf))
+            {
+                dominated = true;
+                break;
+            }
+        }
+        if (!dominated)
+        {
+            front.push_back(s);
+        }
+    }
+    std::sort(
+        front.begin(),
+        front.end(),
+        [](Setting const & a, Setting const & b)
+        {
+            return latency(a.metrics) < latency(b.metrics);
+        }
+    );
+
+    printf(
+        "%lu settings, %u boundary and %u proximity trials and %.0f s parked "
+        "each\n",
+        static_cast<unsigned long>(settings.size()),
+        BOUNDARY_TRIALS,
+        PROXIMITY_TRIALS,
+        PARKED_S
+    );
+    printf("Pareto front, reaction latency vs false positives:\n");
+    print_header();
+    for (Setting const & s : front)
+    {
+        print_setting(s);
+    }
+    printf("defaults:\n");
+    print_setting(defaults);
+    printf(
+        "%.2f s, %.1f settings/sec, %u workers\n",
+        seconds,
+        (settings.size() + 1) / seconds,
+        workers
+    );
+
+    printf("90 degree spin_left() heading error, degrees:\n");
+    printf("  %9s %8s %8s %8s\n", "counts/deg", "200", "300", "400");
+    for (int16_t counts = 3; counts <= 8; ++counts)
+    {
+        printf("  %9d", counts);
+        for (int16_t speed = 200; speed <= 400; speed += 100)
+        {
+            printf(" %8.1f", spin_error(counts, speed));
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+
+// Spin accuracy benchmark: gyro heading against encoder counts.
+//
+// Spins an `IRobot` with `spin_left()` at several speeds and angles, turning
+// by encoder counts and then by the gyro heading, against the simulated
+// wheel, yaw and gyro models: a lagging motor, a biased gyro, and treads
+// that slip by a different amount on every spin. At each spin's encoder
+// event the robot stops, and once it has come to rest its true heading
+// change is compared with the angle asked for. Reports the mean and worst
+// heading error, and the mean time to the event.
+//
+// Encoder spins use the 75:1 entry of the table in robotconfig.h, matching
+// the wheel model's gearing, so their error is the table's rounding plus
+// slip.
+//
+// Usage: turnbench [spins per case] [most tread slip, percent]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "robot.h"
+#include "sim.h"
+
+// Gyro zero rate output, in counts (about 10 degrees per second).
+int16_t const GYRO_BIAS = 150;
+
+// Time to come to rest after a spin, and to measure the bias at start up.
+unsigned long const SETTLE_MS = 400;
+unsigned long const CALIBRATE_MS = 2000;
+
+struct Turns
+{
+    double error_sum;
+    double error_max;
+    double ms_sum;
+    unsigned int spins;
+};
+
+// Run the loop for `ms`, or until an encoder event if `until_event`. Returns
+// whether one was raised.
+static bool run(IRobot & robot, unsigned long ms, bool until_event)
+{
+    unsigned long const start = millis();
+    bool done = false;
+    while (millis() - start < ms && !(until_event && done))
+    {
+        robot.generate_events();
+        while (RobotEventSlot * slot = robot.events().front())
+        {
+            done = done || slot->kind() == ENCODER_EVENT;
+            robot.events().pop();
+        }
+        robot.commit_motors();
+        sim::advance_us(50);
+    }
+    return done;
+}
+
+static Turns spin(
+    IRobot & robot,
+    bool gyro,
+    int16_t speed,
+    int16_t angle,
+    double most_slip,
+    unsigned int spins,
+    uint32_t & seed
+)
+{
+    sim::Hardware & hw = sim::hardware();
+    Turns turns = {0, 0, 0, 0};
+    robot.set_gyro_spins(gyro);
+
+    for (unsigned int i = 0; i < spins; ++i)
+    {
+        hw.tread_slip = most_slip * (sim::next(seed) % 1001) / 1000;
+        double const heading = hw.heading;
+        unsigned long const start_us = sim::now_us();
+
+        robot.spin_left(angle, speed);
+        robot.commit_motors();
+        if (!run(robot, 10000, true))
+        {
+            printf("spin of %d degrees at %d never finished\n", angle, speed);
+            exit(1);
+        }
+        double const ms = (sim::now_us() - start_us) / 1000.0;
+        robot.stop();
+        robot.commit_motors();
+        run(robot, SETTLE_MS, false);
+
+        double const error = fabs(hw.heading - heading - angle);
+        turns.error_sum += error;
+        turns.error_max = error > turns.error_max ? error : turns.error_max;
+        turns.ms_sum += ms;
+        ++turns.spins;
+    }
+    return turns;
+}
+
+int main(int argc, char ** argv)
+{
+    unsigned int const spins = argc > 1 ? strtoul(argv[1], nullptr, 0) : 20;
+    double const most_slip = (argc > 2 ? atof(argv[2]) : 25) / 100;
+    int16_t const speeds[] = {100, 200, 400};
+    int16_t const angles[] = {30, 90, 180};
+    uint32_t seed = 1;
+
+    sim::Hardware & hw = sim::hardware();
+    hw = sim::Hardware();
+    hw.motor_time_constant_s = 0.05;
+    hw.gyro_bias = GYRO_BIAS;
+
+    IRobot robot;
+    robot.setup();
+    RobotConfig config = robot.config();
+    config.encoder_counts_per_degree = 6;
+    robot.set_config(config);
+    run(robot, CALIBRATE_MS, false);
+
+    printf(
+        "spin_left() heading error at rest, degrees, and time to the "
+        "encoder event\n(tread slip 0 to %.0f%%, gyro bias %.1f deg/s, "
+        "%u spins per case)\n",
+        most_slip * 100,
+        GYRO_BIAS * 0.07,
+        spins
+    );
+    printf(
+        "%6s %6s | %-25s | %-25s\n",
+        "",
+        "",
+        "      encoder counts",
+        "      gyro heading"
+    );
+    printf(
+        "%6s %6s | %7s %7s %9s | %7s %7s %9s\n",
+        "speed", "deg",
+        "mean", "max", "ms",
+        "mean", "max", "ms"
+    );
+    for (int16_t speed : speeds)
+    {
+        for (int16_t angle : angles)
+        {
+            Turns const encoder =
+                spin(robot, false, speed, angle, most_slip, spins, seed);
+            Turns const gyro =
+                spin(robot, true, speed, angle, most_slip, spins, seed);
+            printf(
+                "%6d %6d | %7.1f %7.1f %9.0f | %7.1f %7.1f %9.0f\n",
+                speed,
+                angle,
+                encoder.error_sum / encoder.spins,
+                encoder.error_max,
+                encoder.ms_sum / encoder.spins,
+                gyro.error_sum / gyro.spins,
+                gyro.error_max,
+                gyro.ms_sum / gyro.spins
+            );
+        }
+    }
+    printf(
+        "gyro: %lu samples, %lu overruns, bias %.1f counts\n",
+        robot.gyro().samples(),
+        robot.gyro().overruns(),
+        robot.heading().bias() / 256.0
+    );
+}
@@ -0,0 +1,113 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include "imufifo.h"
+
+// LSM303D CTRL0 and L3GD20H CTRL5: FIFO enabled. FIFO_CTRL: stream mode.
+// FIFO_SRC: overrun flag and sample count. Both sensors use the same
+// register addresses for the FIFO and its output.
+static uint8_t const FIFO_EN = 0x40;
+static uint8_t const STREAM_MODE = 0x40;
+static uint8_t const FIFO_CTRL = 0x2E;
+static uint8_t const FIFO_SRC = 0x2F;
+static uint8_t const OUT_X_L = 0x28;
+static uint8_t const FIFO_OVERRUN = 0x40;
+static uint8_t const FIFO_LEVEL = 0x1F;
+
+// LSM303D CTRL1: x, y and z enabled. CTRL2: +/-8 g.
+static uint8_t const ACCELEROMETER_AXES = 0x07;
+static uint8_t const FULL_SCALE_8G = 0x18;
+
+// L3GD20H CTRL1: highest bandwidth for the rate, powered up, x, y and z
+// enabled. CTRL4: +/-2000 degrees per second.
+static uint8_t const GYRO_BANDWIDTH = 0x30;
+static uint8_t const GYRO_POWER_AXES = 0x0F;
+static uint8_t const FULL_SCALE_2000DPS = 0x20;
+
+// Set on a register address for the transfer to auto-increment through the
+// registers. Reads of the output registers then roll over from sample to
+// sample in the FIFO.
+static uint8_t const AUTO_INCREMENT = 0x80;
+
+ImuFifo::ImuFifo() :
+    m_address(0),
+    m_samples(0),
+    m_overruns(0)
+{}
+
+void ImuFifo::init(LSM303 & accelerometer)
+{
+    begin(LSM303D_ADDRESS);
+    accelerometer.writeReg(LSM303::CTRL2, FULL_SCALE_8G);
+    accelerometer.writeReg(
+        LSM303::CTRL1,
+        ACCELEROMETER_RATE << 4 | ACCELEROMETER_AXES
+    );
+    accelerometer.writeReg(LSM303::FIFO_CTRL, STREAM_MODE);
+    accelerometer.writeReg(LSM303::CTRL0, FIFO_EN);
+}
+
+void ImuFifo::init(L3G & gyro)
+{
+    begin(L3GD20H_ADDRESS);
+    gyro.writeReg(L3G::LOW_ODR, 0);
+    gyro.writeReg(L3G::CTRL4, FULL_SCALE_2000DPS);
+    gyro.writeReg(
+        L3G::CTRL1,
+        GYRO_RATE << 6 | GYRO_BANDWIDTH | GYRO_POWER_AXES
+    );
+    gyro.writeReg(L3G::FIFO_CTRL, STREAM_MODE);
+    gyro.writeReg(L3G::CTRL5, FIFO_EN);
+}
+
+uint8_t ImuFifo::available()
+{
+    Wire.beginTransmission(m_address);
+    Wire.write(FIFO_SRC);
+    Wire.endTransmission();
+    Wire.requestFrom(m_address, static_cast<uint8_t>(1));
+    uint8_t const source = Wire.read();
+    if (source & FIFO_OVERRUN)
+    {
+        ++m_overruns;
+    }
+    return source & FIFO_LEVEL;
+}
+
+void ImuFifo::read(int16_t (*samples)[3], uint8_t count)
+{
+    Wire.beginTransmission(m_address);
+    Wire.write(OUT_X_L | AUTO_INCREMENT);
+    Wire.endTransmission();
+    Wire.requestFrom(m_address, static_cast<uint8_t>(count * 6));
+
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        for (uint8_t axis = 0; axis < 3; ++axis)
+        {
+            uint8_t const low = Wire.read();
+            uint8_t const high = Wire.read();
+            samples[i][axis] = static_cast<int16_t>(high << 8 | low);
+        }
+    }
+    m_samples += count;
+}
+
+unsigned long ImuFifo::samples() const
+{
+    return m_samples;
+}
+
+unsigned long ImuFifo::overruns() const
+{
+    return m_overruns;
+}
+
+void ImuFifo::begin(uint8_t address)
+{
+    m_address = address;
+    m_samples = m_overruns = 0;
+}
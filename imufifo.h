@@ -0,0 +1,77 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <Wire.h>
+#include <Zumo32U4.h>
+
+// Accelerometer output data rate code (AODR in CTRL1): 8 => 400, 9 => 800,
+// 10 => 1600 samples per second. The 32 sample FIFO must be read before it
+// fills: every 80 ms at 400 per second. Each sample costs about 140 us of
+// blocking I2C transfer at 400 kHz, so 400 per second already spends over
+// 5% of the loop's time reading them.
+#ifndef ACCELEROMETER_RATE
+#define ACCELEROMETER_RATE 8
+#endif
+
+// Gyro output data rate code (DR in CTRL1): 0 => 100, 1 => 200, 2 => 400,
+// 3 => 800 samples per second. 200 per second resolves a full speed spin
+// to under 5 degrees per sample, for about 4% of the loop's time read in
+// bursts every 10 ms.
+#ifndef GYRO_RATE
+#define GYRO_RATE 1
+#endif
+
+// LSM303D accelerometer or L3GD20H gyro, sampling into its FIFO.
+//
+// The sensor samples at a fixed rate whatever the loop is doing, and the
+// samples wait in its FIFO, so none are lost while the loop is blocked in
+// another driver. Reading them in bursts, several samples per I2C transfer,
+// spends the transfer overhead (addressing, and the register address) once
+// per burst rather than once per sample, which is most of the cost of a
+// single sample read. Both sensors have the same FIFO and output registers,
+// so only `init()` differs between them.
+class ImuFifo
+{
+public:
+    // Most samples per burst: as many as fit in the Wire library's buffer.
+    static uint8_t const BURST = BUFFER_LENGTH / 6;
+
+    ImuFifo();
+
+    // Configure `accelerometer` for +/-8 g at ACCELEROMETER_RATE, x, y and
+    // z, with the FIFO in stream mode. Call after `init()`.
+    void init(LSM303 & accelerometer);
+
+    // Configure `gyro` for +/-2000 degrees per second at GYRO_RATE, x, y
+    // and z, with the FIFO in stream mode. Call after `init()`.
+    void init(L3G & gyro);
+
+    // Number of samples waiting. Also notes FIFO overruns.
+    uint8_t available();
+
+    // Read the `count` (at most BURST) oldest samples into `samples`, as
+    // x, y and z in raw counts, in one transfer.
+    void read(int16_t (*samples)[3], uint8_t count);
+
+    // Samples read, and reads that found the FIFO had overrun (samples
+    // lost), since `init()`.
+    unsigned long samples() const;
+    unsigned long overruns() const;
+
+private:
+    // I2C addresses with SA0 high, as on the Zumo 32U4.
+    static uint8_t const LSM303D_ADDRESS = 0x1D;
+    static uint8_t const L3GD20H_ADDRESS = 0x6B;
+
+    void begin(uint8_t address);
+
+    uint8_t m_address;
+    unsigned long m_samples;
+    unsigned long m_overruns;
+};
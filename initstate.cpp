@@ -5,17 +5,15 @@
     LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
  */
 #include "initstate.h"
-#include "standbystate.h"
-
-extern StandbyState standby;
+#include "robotstatemachine.h"
 
 InitState::InitState(State * parent, IRobot & robot) :
-    RobotState("init", parent, robot)
+    RobotStateT(STATEMACHINE_NAME("init"), parent, robot)
 {}
 
 bool InitState::on_event(StartButtonEvent & event)
 {
-    transition_to_state(standby);
+    transition_to_state(machine().standby());
 
     return true;
 }
\ No newline at end of file
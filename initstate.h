@@ -8,11 +8,13 @@
 
 #include "robotstate.h"
 
-class InitState : public RobotState
+class InitState : public RobotStateT<InitState, StartButtonEvent>
 {
+    friend RobotStateT;
+
 public:
     InitState(State * parent, IRobot & robot);
 
 protected:
-    bool on_event(StartButtonEvent & event) override;
+    bool on_event(StartButtonEvent & event);
 };
@@ -0,0 +1,79 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include <string.h>
+
+#include "profiler.h"
+
+#ifdef PROFILING
+
+Profiler profiler;
+
+void ProfileHistogram::record(uint32_t ticks)
+{
+    uint8_t bucket = 0;
+    for (uint32_t t = ticks; t && bucket < PROFILE_BUCKETS - 1; t >>= 1)
+    {
+        ++bucket;
+    }
+
+    if (buckets[bucket] != 0xFFFF)
+    {
+        ++buckets[bucket];
+    }
+    ++count;
+    total += ticks;
+    if (ticks > max)
+    {
+        max = ticks > 0xFFFF ? 0xFFFF : ticks;
+    }
+}
+
+Profiler::Profiler()
+{
+    reset();
+}
+
+void Profiler::reset()
+{
+    memset(m_stages, 0, sizeof(m_stages));
+    memset(m_handlers, 0, sizeof(m_handlers));
+    for (char const * & name : m_state_names)
+    {
+        name = nullptr;
+    }
+}
+
+char const * Profiler::stage_name(uint8_t stage)
+{
+    static char const * const names[PROFILE_STAGE_COUNT] =
+    {
+        "loop",
+        "button",
+        "timers",
+        "line",
+        "encoders",
+        "proximity",
+        "accel",
+        "gyro",
+        "drain",
+        "display"
+    };
+    return names[stage];
+}
+
+char const * Profiler::handler_name(uint8_t handler)
+{
+    static char const * const names[PROFILE_HANDLER_COUNT] =
+    {
+        "on_event",
+        "on_entry",
+        "on_exit"
+    };
+    return names[handler];
+}
+
+#endif
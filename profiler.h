@@ -0,0 +1,258 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+// Loop and handler profiler.
+//
+// Probes time a stage of `loop()`, and the profiler, as the state machine's
+// handler hook (see `RobotStateMachine`), each state's `on_event()`,
+// `on_entry()` and `on_exit()`. Each time is added to a fixed-bucket histogram
+// held in RAM. `profiler.dump(Serial)` prints the histograms on demand.
+//
+// Probes and the hook compile out completely unless PROFILING is defined,
+// e.g. with `-DPROFILING` in the build flags. Elapsed time is read from
+// PROFILE_CLOCK(), micros() unless the build defines another free-running
+// counter.
+
+#ifdef PROFILING
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "statemachine.h"
+
+#ifndef PROFILE_CLOCK
+#define PROFILE_CLOCK() micros()
+#endif
+
+// Histogram bucket 0 counts times of 0 ticks, and bucket `i` times of
+// 2^(i - 1) up to 2^i - 1 ticks. The last bucket is open-ended.
+#ifndef PROFILE_BUCKETS
+#define PROFILE_BUCKETS 14
+#endif
+
+// States profiled, by their index in the frozen state machine.
+#ifndef PROFILE_STATES
+#define PROFILE_STATES 4
+#endif
+
+// Stages of `loop()`.
+enum ProfileStage : uint8_t
+{
+    PROFILE_LOOP,
+    PROFILE_BUTTON,
+    PROFILE_TIMERS,
+    PROFILE_LINE,
+    PROFILE_ENCODERS,
+    PROFILE_PROXIMITY,
+    PROFILE_ACCELEROMETER,
+    PROFILE_GYRO,
+    PROFILE_DRAIN,
+    PROFILE_DISPLAY,
+    PROFILE_STAGE_COUNT
+};
+
+// State handlers, numbered as the state machine's.
+enum ProfileHandler : uint8_t
+{
+    PROFILE_ON_EVENT = statemachine::State::ON_EVENT,
+    PROFILE_ON_ENTRY = statemachine::State::ON_ENTRY,
+    PROFILE_ON_EXIT = statemachine::State::ON_EXIT,
+    PROFILE_HANDLER_COUNT
+};
+
+struct ProfileHistogram
+{
+    void record(uint32_t ticks);
+
+    uint32_t count;
+    uint32_t total;
+    uint16_t max;
+    // Saturate at 0xFFFF.
+    uint16_t buckets[PROFILE_BUCKETS];
+};
+
+class Profiler : public statemachine::State::Hook
+{
+public:
+    Profiler();
+
+    // Handler hook: times each state handler the machine calls.
+    uint32_t before(
+        statemachine::State & state,
+        statemachine::State::Handler handler
+    ) override
+    {
+        return PROFILE_CLOCK();
+    }
+
+    void after(
+        statemachine::State & state,
+        statemachine::State::Handler handler,
+        uint32_t start
+    ) override
+    {
+        record_handler(
+            state.index(),
+            state.name(),
+            handler,
+            PROFILE_CLOCK() - start
+        );
+    }
+
+    // Clear all histograms.
+    void reset();
+
+    void record(uint8_t stage, uint32_t ticks)
+    {
+        m_stages[stage].record(ticks);
+    }
+
+    // `state` is the state's frozen index. States past PROFILE_STATES, and
+    // states missing from the frozen table (NO_STATE), are not recorded.
+    void record_handler(
+        uint8_t state,
+        char const * state_name,
+        uint8_t handler,
+        uint32_t ticks
+    )
+    {
+        if (state != statemachine::State::NO_STATE && state < PROFILE_STATES)
+        {
+            m_state_names[state] = state_name;
+            m_handlers[state][handler].record(ticks);
+        }
+    }
+
+    ProfileHistogram const & stage(uint8_t stage) const
+    {
+        return m_stages[stage];
+    }
+
+    ProfileHistogram const & handler(uint8_t state, uint8_t handler) const
+    {
+        return m_handlers[state][handler];
+    }
+
+    // Name of profiled state `state`, or nullptr if it has not run. See
+    // `statemachine::read_name()`.
+    char const * state_name(uint8_t state) const
+    {
+        return m_state_names[state];
+    }
+
+    static char const * stage_name(uint8_t stage);
+    static char const * handler_name(uint8_t handler);
+
+    // Smallest time counted in `bucket`.
+    static uint32_t bucket_floor(uint8_t bucket)
+    {
+        return bucket ? 1UL << (bucket - 1) : 0;
+    }
+
+    // Print every histogram that has samples to `out`, which needs
+    // `print(char const *)`, `print(unsigned long)` and `println()`, as
+    // Arduino's `Serial` has. Each line lists the name, sample count, mean
+    // and maximum, then `floor:count` for each non-empty bucket.
+    template <typename Out>
+    void dump(Out & out) const
+    {
+        for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; ++i)
+        {
+            dump_histogram(out, stage_name(i), nullptr, m_stages[i]);
+        }
+        for (uint8_t i = 0; i < PROFILE_STATES; ++i)
+        {
+            // Names are in program memory in the compact state machine build.
+            char name[16] = "";
+            if (m_state_names[i])
+            {
+                statemachine::read_name(m_state_names[i], name, sizeof(name));
+            }
+            for (uint8_t j = 0; j < PROFILE_HANDLER_COUNT; ++j)
+            {
+                dump_histogram(
+                    out,
+                    name,
+                    handler_name(j),
+                    m_handlers[i][j]
+                );
+            }
+        }
+    }
+
+private:
+    template <typename Out>
+    static void dump_histogram(
+        Out & out,
+        char const * name,
+        char const * handler,
+        ProfileHistogram const & h
+    )
+    {
+        if (!h.count)
+        {
+            return;
+        }
+
+        out.print(name);
+        if (handler)
+        {
+            out.print(".");
+            out.print(handler);
+        }
+        out.print(" n=");
+        out.print((unsigned long)h.count);
+        out.print(" mean=");
+        out.print((unsigned long)(h.total / h.count));
+        out.print(" max=");
+        out.print((unsigned long)h.max);
+        for (uint8_t i = 0; i < PROFILE_BUCKETS; ++i)
+        {
+            if (h.buckets[i])
+            {
+                out.print(" ");
+                out.print((unsigned long)bucket_floor(i));
+                out.print(":");
+                out.print((unsigned long)h.buckets[i]);
+            }
+        }
+        out.println();
+    }
+
+    ProfileHistogram m_stages[PROFILE_STAGE_COUNT];
+    ProfileHistogram m_handlers[PROFILE_STATES][PROFILE_HANDLER_COUNT];
+    char const * m_state_names[PROFILE_STATES];
+};
+
+extern Profiler profiler;
+
+// Records the time from construction to the end of the enclosing scope.
+class ProfileProbe
+{
+public:
+    explicit ProfileProbe(uint8_t stage) :
+        m_start(PROFILE_CLOCK()),
+        m_stage(stage)
+    {}
+
+    ~ProfileProbe()
+    {
+        profiler.record(m_stage, PROFILE_CLOCK() - m_start);
+    }
+
+private:
+    uint32_t const m_start;
+    uint8_t const m_stage;
+};
+
+#define PROFILE_SCOPE(stage) ProfileProbe profile_probe(stage)
+
+#else
+
+#define PROFILE_SCOPE(stage)
+
+#endif
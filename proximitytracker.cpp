@@ -0,0 +1,127 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include "proximitytracker.h"
+
+// Bearing of an opponent seen only by a side sensor, and the largest bearing
+// the front sensor reports.
+static int16_t const SIDE_DEGREES = 90;
+static int16_t const FRONT_MAX_DEGREES = 60;
+
+// Bearings within AHEAD_DEGREES of centre are AHEAD on a new detection. Once
+// detected, the direction changes only when the bearing is HYSTERESIS_DEGREES
+// past that line.
+static int16_t const AHEAD_DEGREES = 9;
+static int16_t const HYSTERESIS_DEGREES = 3;
+
+// Largest proximity count.
+static int16_t const MAX_COUNT = 6;
+
+ProximityTracker::ProximityTracker()
+{
+    reset();
+}
+
+void ProximityTracker::reset()
+{
+    m_detected = false;
+    m_direction = NONE;
+    m_bearing = 0;
+    m_confidence = 0;
+}
+
+void ProximityTracker::update(
+    uint8_t front_left,
+    uint8_t front_right,
+    uint8_t left,
+    uint8_t right,
+    uint8_t threshold
+)
+{
+    bool const front = front_left >= threshold || front_right >= threshold;
+    bool const side_left = left >= threshold;
+    bool const side_right = right >= threshold;
+    m_detected = front || side_left || side_right;
+
+    // Confidence follows the strongest reading.
+    uint8_t strength = front_left > front_right ? front_left : front_right;
+    strength = left > strength ? left : strength;
+    strength = right > strength ? right : strength;
+    int16_t const target = m_detected ?
+        (strength < MAX_COUNT ? strength : MAX_COUNT) * 255 / MAX_COUNT : 0;
+    bool const fresh = m_confidence == 0;
+    int16_t step = (target - m_confidence) / (1 << PROXIMITY_FILTER_SHIFT);
+    m_confidence += step ? step : target - m_confidence;
+
+    if (!m_detected)
+    {
+        m_direction = NONE;
+        return;
+    }
+
+    int16_t raw;
+    if (front)
+    {
+        raw = (static_cast<int16_t>(front_left) - front_right) *
+            PROXIMITY_DEGREES_PER_COUNT;
+        raw = raw > FRONT_MAX_DEGREES ? FRONT_MAX_DEGREES :
+            raw < -FRONT_MAX_DEGREES ? -FRONT_MAX_DEGREES : raw;
+    }
+    else
+    {
+        raw = left >= right ? SIDE_DEGREES : -SIDE_DEGREES;
+    }
+
+    if (fresh)
+    {
+        m_bearing = raw * 256;
+    }
+    else
+    {
+        int32_t const error = static_cast<int32_t>(raw) * 256 - m_bearing;
+        m_bearing += error / (1 << PROXIMITY_FILTER_SHIFT);
+    }
+
+    int16_t const b = bearing();
+    int16_t const enter = AHEAD_DEGREES + HYSTERESIS_DEGREES;
+    int16_t const leave = AHEAD_DEGREES - HYSTERESIS_DEGREES;
+    switch (m_direction)
+    {
+    case NONE:
+        m_direction = b > AHEAD_DEGREES ? LEFT :
+            b < -AHEAD_DEGREES ? RIGHT : AHEAD;
+        break;
+    case LEFT:
+        m_direction = b < -enter ? RIGHT : b < leave ? AHEAD : LEFT;
+        break;
+    case RIGHT:
+        m_direction = b > enter ? LEFT : b > -leave ? AHEAD : RIGHT;
+        break;
+    default:
+        m_direction = b > enter ? LEFT : b < -enter ? RIGHT : AHEAD;
+        break;
+    }
+}
+
+bool ProximityTracker::detected() const
+{
+    return m_detected;
+}
+
+DetectDirection ProximityTracker::direction() const
+{
+    return m_direction;
+}
+
+int8_t ProximityTracker::bearing() const
+{
+    return m_bearing / 256;
+}
+
+uint8_t ProximityTracker::confidence() const
+{
+    return m_confidence;
+}
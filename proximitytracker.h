@@ -0,0 +1,72 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "events.h"
+
+// Degrees of bearing per count of difference between the front sensor's
+// readings with the left and right LEDs. Depends on the LEDs and the
+// opponent; check it by placing the opponent at known bearings.
+#ifndef PROXIMITY_DEGREES_PER_COUNT
+#define PROXIMITY_DEGREES_PER_COUNT 12
+#endif
+
+// Each read moves the filtered bearing and confidence 1 / 2^shift of the way
+// to the new estimate. 1 halves the error every read (every 20 ms by default).
+#ifndef PROXIMITY_FILTER_SHIFT
+#define PROXIMITY_FILTER_SHIFT 1
+#endif
+
+// Proximity bearing estimation.
+//
+// Combines the front sensor (read with the left and the right LEDs) and the
+// side sensors into a bearing to the opponent, in degrees, positive to the
+// left, and a confidence, 0 through 255. The front sensor gives bearings
+// within its field of view from the difference between its two readings;
+// the side sensors alone put the opponent square to either side.
+//
+// Both are smoothed by an exponential filter, in 8.8 fixed point. A new
+// detection starts from its own estimate rather than a stale one. The
+// direction reported in events is taken from the filtered bearing, with
+// hysteresis between AHEAD and either side, so it does not flicker on single
+// count noise. Whether anything is detected at all is not filtered, so
+// detection latency is one read.
+class ProximityTracker
+{
+public:
+    ProximityTracker();
+
+    void reset();
+
+    // Update from one read of the sensors. Counts of at least `threshold`
+    // are detections.
+    void update(
+        uint8_t front_left,
+        uint8_t front_right,
+        uint8_t left,
+        uint8_t right,
+        uint8_t threshold
+    );
+
+    bool detected() const;
+    DetectDirection direction() const;
+
+    // Filtered bearing, in degrees, positive to the left. Holds the last
+    // estimate while nothing is detected.
+    int8_t bearing() const;
+
+    // Filtered detection strength, 0 through 255. Decays while nothing is
+    // detected.
+    uint8_t confidence() const;
+
+private:
+    bool m_detected;
+    DetectDirection m_direction;
+    int16_t m_bearing;
+    int16_t m_confidence;
+};
@@ -5,237 +5,756 @@
     LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
  */
 #include "events.h"
+#include "profiler.h"
 #include "robot.h"
 
-// Events.
-
-BoundaryEvent boundary_event;
-EncoderEvent encoder_event;
-StartButtonEvent start_event;
-TimerEvent timer_event;
-ProximityEvent proximity_event;
-
-// Static helper functions.
-
-static int16_t clip_speed(int16_t speed)
-{
-    int16_t const max_speed = 400;
-    int16_t const min_speed = -max_speed;
-
-    if (speed > max_speed)
-    {
-        speed = max_speed;
-    }
-    else if (speed < min_speed)
-    {
-        speed = min_speed;
-    }
-
-    return speed;
-}
-
 // IRobot methods.
 
 void IRobot::setup()
 {
-    m_end_time = 0;
-    m_encoder_count = 0;
-
-    // Set up accelerometer.
+    m_timers.reset(millis());
+    m_left_counts = m_right_counts = 0;
+    m_left_motor_speed = m_right_motor_speed = 0;
+    m_speed_control = false;
+    m_motors_staged = false;
+    m_left_motor_output = m_right_motor_output = 0;
+    m_motor_commands = m_motor_writes = 0;
+    m_left_committed_speed = m_right_committed_speed = 0;
+    m_motion_ms = millis();
+    m_gyro_spins = true;
+    m_spin_active = m_spin_steering = false;
+
+    // Line sensors on every pass, since the boundary is the most urgent
+    // input. Proximity sensors pulse the IR emitters for a few milliseconds,
+    // so they are read less often. The accelerometer and gyro sample into
+    // their FIFOs on their own, so they are emptied in bursts, well before
+    // the FIFOs fill. The gyro is not slow, since a spin's end waits on it.
+    set_sensor_schedule(START_BUTTON_SENSOR, 10000, 0, false);
+    set_sensor_schedule(LINE_SENSORS, 0, 0, false);
+    set_sensor_schedule(ENCODER_SENSORS, 0, 0, false);
+    set_sensor_schedule(PROXIMITY_SENSORS, 20000, 0, true);
+    set_sensor_schedule(ACCELEROMETER_SENSOR, 10000, 0, true);
+    set_sensor_schedule(GYRO_SENSOR, 10000, 5000, false);
+    m_sensors.reset_stats(micros());
+
+    // Report every detection. Sketches opt in to fewer events.
+    set_event_policy(BOUNDARY_EVENT, LEVEL);
+    set_event_policy(PROXIMITY_EVENT, LEVEL);
+
+    // Set up LCD.
+    m_display.setup();
+
+    // Set up accelerometer, on a fast (400 kHz) I2C bus.
+    Wire.begin();
+    Wire.setClock(400000);
     m_accelerometer.init();
+    m_accelerometer_fifo.init(m_accelerometer);
+    m_contact_detector.reset();
+    m_contact_detector.configure(
+        m_config.collision_threshold,
+        m_config.push_threshold
+    );
 
     // Set up line sensors.
-    m_boundary_sensor.initThreeSensors();
+    if (LINE_SENSOR_COUNT == 5)
+    {
+        m_boundary_sensor.initFiveSensors();
+    }
+    else
+    {
+        m_boundary_sensor.initThreeSensors();
+    }
+    m_line_classifier.configure(
+        m_config.boundary_threshold,
+        m_config.boundary_fraction
+    );
 
     // Set up gyro.
-//    m_gyro.init();
+    m_gyro.init();
+    m_gyro_fifo.init(m_gyro);
+    m_heading.reset();
+    m_gyro_left_counts = m_gyro_right_counts = 0;
 
     // Set up proximity sensors.
-    m_proximity_sensors.initFrontSensor();
+    if (LINE_SENSOR_COUNT == 5)
+    {
+        m_proximity_sensors.initFrontSensor();
+    }
+    else
+    {
+        m_proximity_sensors.initThreeSensors();
+    }
+    m_proximity.reset();
 }
 
-void IRobot::generate_events(EventQueue & q)
+void IRobot::generate_events()
 {
+    EventQueue & q = m_events;
+
+    m_sensors.begin_pass(micros());
+
     // Check start button.
-    if (m_start_button.getSingleDebouncedPress())
+    if (m_sensors.start(START_BUTTON_SENSOR))
     {
-        q.push(&start_event);
+        PROFILE_SCOPE(PROFILE_BUTTON);
+        bool const pressed = m_start_button.getSingleDebouncedPress();
+        m_sensors.finish(START_BUTTON_SENSOR);
+        if (pressed)
+        {
+            q.push(StartButtonEvent());
+        }
     }
 
-    // Check timer.
-    if (m_end_time && millis() >= m_end_time)
+    // Check timers.
     {
-        q.push(&timer_event);
-        m_end_time = 0;
+        PROFILE_SCOPE(PROFILE_TIMERS);
+        m_timers.expire(
+            millis(),
+            [&q](uint8_t timer) { q.push(TimerEvent(timer)); }
+        );
     }
 
     // Check boundary sensors.
-    switch(boundary_detect())
+    if (m_sensors.start(LINE_SENSORS))
     {
-    case BOUNDARY_AHEAD:
-        boundary_event.m_direction = AHEAD;
-        q.push(&boundary_event);
-        break;
-    case BOUNDARY_LEFT:
-        boundary_event.m_direction = LEFT;
-        q.push(&boundary_event);
-        break;
-    case BOUNDARY_RIGHT:
-        boundary_event.m_direction = RIGHT;
-        q.push(&boundary_event);
-        break;
-    default:
-        boundary_event.m_direction = NONE;
-        // Do not push event onto queue.
-        break;
+        PROFILE_SCOPE(PROFILE_LINE);
+        DetectDirection boundary = NONE;
+        switch(boundary_detect())
+        {
+        case BOUNDARY_AHEAD:
+            boundary = AHEAD;
+            break;
+        case BOUNDARY_LEFT:
+            boundary = LEFT;
+            break;
+        case BOUNDARY_RIGHT:
+            boundary = RIGHT;
+            break;
+        default:
+            break;
+        }
+        m_sensors.finish(LINE_SENSORS);
+        if (m_boundary_filter.accept(boundary, millis()))
+        {
+            q.push_or_replace(BoundaryEvent(boundary));
+        }
     }
 
     // Check encoders.
-    if (m_encoder_count && abs(m_encoders.getCountsLeft()) > m_encoder_count)
+    check_encoders();
+
+    // Check proximity sensor.
+    if (m_sensors.start(PROXIMITY_SENSORS))
     {
-        q.push(&encoder_event);
-        m_encoder_count = 0;
+        PROFILE_SCOPE(PROFILE_PROXIMITY);
+        uint8_t const proximity_threshold = m_config.proximity_threshold;
+        m_proximity_sensors.read();
+        m_sensors.finish(PROXIMITY_SENSORS);
+
+        // The wheels kept turning during the read.
+        check_encoders();
+
+        uint8_t const brightness_left =
+            m_proximity_sensors.countsFrontWithLeftLeds();
+        uint8_t const brightness_right =
+            m_proximity_sensors.countsFrontWithRightLeds();
+        uint8_t side_left = 0;
+        uint8_t side_right = 0;
+        if (LINE_SENSOR_COUNT != 5)
+        {
+            side_left = m_proximity_sensors.countsLeftWithLeftLeds();
+            side_right = m_proximity_sensors.countsRightWithRightLeds();
+        }
+        m_proximity.update(
+            brightness_left,
+            brightness_right,
+            side_left,
+            side_right,
+            proximity_threshold
+        );
+        DetectDirection const direction = m_proximity.direction();
+        if (m_proximity_filter.accept(direction, millis()))
+        {
+            q.push_or_replace(
+                ProximityEvent(
+                    direction,
+                    brightness_left,
+                    brightness_right,
+                    m_proximity.bearing(),
+                    m_proximity.confidence()
+                )
+            );
+        }
     }
 
-    // Check proximity sensor.
-    uint8_t const proximity_threshold = 1;
-    m_proximity_sensors.read();
-    uint8_t brightness_left = m_proximity_sensors.countsFrontWithLeftLeds();
-    uint8_t brightness_right = m_proximity_sensors.countsFrontWithRightLeds();
-    if (
-        brightness_left >= proximity_threshold || 
-        brightness_right >= proximity_threshold
-    )
+    // Check accelerometer.
+    if (m_sensors.start(ACCELEROMETER_SENSOR))
     {
-        // Object detected.
-        if (brightness_left > brightness_right)
+        PROFILE_SCOPE(PROFILE_ACCELEROMETER);
+        bool const settled = millis() - m_motion_ms >= CONTACT_SETTLE_MS;
+        uint8_t waiting = m_accelerometer_fifo.available();
+        while (waiting)
         {
-            proximity_event.m_direction = LEFT;
-            q.push(&proximity_event);
+            int16_t samples[ImuFifo::BURST][3];
+            uint8_t const count =
+                waiting < ImuFifo::BURST ? waiting : ImuFifo::BURST;
+            m_accelerometer_fifo.read(samples, count);
+            waiting -= count;
+            for (uint8_t i = 0; i < count; ++i)
+            {
+                ContactDetector & d = m_contact_detector;
+                if (d.update(samples[i][0], samples[i][1], settled))
+                {
+                    q.push(ContactEvent(d.type(), d.side(), d.strength()));
+                }
+            }
         }
-        else if (brightness_right > brightness_left)
+        m_sensors.finish(ACCELEROMETER_SENSOR);
+    }
+
+    // Check gyro.
+    if (m_sensors.start(GYRO_SENSOR))
+    {
+        PROFILE_SCOPE(PROFILE_GYRO);
+        bool const still = m_left_motor_output == 0 &&
+            m_right_motor_output == 0 &&
+            millis() - m_motion_ms >= GYRO_STILL_MS &&
+            m_left_counts == m_gyro_left_counts &&
+            m_right_counts == m_gyro_right_counts;
+        m_gyro_left_counts = m_left_counts;
+        m_gyro_right_counts = m_right_counts;
+        uint8_t waiting = m_gyro_fifo.available();
+        while (waiting)
         {
-            proximity_event.m_direction = RIGHT;
-            q.push(&proximity_event);
+            int16_t samples[ImuFifo::BURST][3];
+            uint8_t const count =
+                waiting < ImuFifo::BURST ? waiting : ImuFifo::BURST;
+            m_gyro_fifo.read(samples, count);
+            waiting -= count;
+            for (uint8_t i = 0; i < count; ++i)
+            {
+                m_heading.update(samples[i][2], still);
+            }
         }
-        else
+        m_sensors.finish(GYRO_SENSOR);
+        if (m_spin_active)
         {
-            proximity_event.m_direction = AHEAD;
-            q.push(&proximity_event);
+            steer_spin();
         }
     }
-    else
+}
+
+void IRobot::set_event_policy(
+    RobotEvent source,
+    EventPolicy policy,
+    uint16_t period_ms
+)
+{
+    switch (source)
     {
-        proximity_event.m_direction = NONE;
-        q.push(&proximity_event);
+    case BOUNDARY_EVENT:
+        m_boundary_filter.set_policy(policy, period_ms, false);
+        break;
+    case PROXIMITY_EVENT:
+        m_proximity_filter.set_policy(policy, period_ms, true);
+        break;
+    default:
+        // Other sources generate one event per occurrence.
+        break;
     }
 }
 
+void IRobot::set_sensor_schedule(
+    SensorSource source,
+    unsigned long period_us,
+    unsigned long phase_us,
+    bool slow
+)
+{
+    m_sensors.set_schedule(source, period_us, phase_us, slow, micros());
+}
+
+SensorScheduler const & IRobot::sensor_schedule() const
+{
+    return m_sensors;
+}
+
+unsigned long IRobot::suppressed_events() const
+{
+    return m_boundary_filter.suppressed() + m_proximity_filter.suppressed();
+}
+
 void IRobot::display(char const * msg)
 {
-    m_lcd.clear();
-    m_lcd.write(msg, strlen(msg));
+    m_display.clear();
+    m_display.print(0, msg);
 }
 
-void IRobot::cancel_timer()
+void IRobot::update_display()
 {
-    m_end_time = 0;
+    PROFILE_SCOPE(PROFILE_DISPLAY);
+    m_display.update(m_display_budget_us);
 }
 
-void IRobot::start_timer(unsigned long timeout_in_ms)
+EventQueue & IRobot::events()
 {
-    m_end_time = millis() + timeout_in_ms;
-    if (m_end_time == 0)
-    {
-        // End time cannot be zero, because event won't trigger.
-        m_end_time = 1;
-    }
+    return m_events;
+}
+
+void IRobot::set_config(RobotConfig const & config)
+{
+    m_config = config;
+    m_line_classifier.configure(
+        m_config.boundary_threshold,
+        m_config.boundary_fraction
+    );
+    m_contact_detector.configure(
+        m_config.collision_threshold,
+        m_config.push_threshold
+    );
+}
+
+RobotConfig const & IRobot::config() const
+{
+    return m_config;
+}
+
+void IRobot::calibrate_line_sensors()
+{
+    unsigned int sensor_values[LINE_SENSOR_COUNT];
+    m_boundary_sensor.read(sensor_values);
+    m_line_classifier.calibrate(sensor_values);
+}
+
+void IRobot::reset_line_calibration()
+{
+    m_line_classifier.reset_calibration();
+}
+
+void IRobot::set_line_calibration(
+    LineClassifier::Calibration const & calibration
+)
+{
+    m_line_classifier.set_calibration(calibration);
+}
+
+LineClassifier const & IRobot::line_classifier() const
+{
+    return m_line_classifier;
+}
+
+ProximityTracker const & IRobot::proximity_tracker() const
+{
+    return m_proximity;
+}
+
+ImuFifo const & IRobot::accelerometer() const
+{
+    return m_accelerometer_fifo;
+}
+
+GyroHeading const & IRobot::heading() const
+{
+    return m_heading;
+}
+
+ImuFifo const & IRobot::gyro() const
+{
+    return m_gyro_fifo;
+}
+
+void IRobot::cancel_timer(uint8_t timer)
+{
+    m_timers.cancel(timer);
+}
+
+void IRobot::start_timer(unsigned long timeout_in_ms, uint8_t timer)
+{
+    m_timers.start(timer, millis(), timeout_in_ms);
 }
 
 void IRobot::change_speed_by(int16_t delta)
 {
     m_left_motor_speed = clip_speed(m_left_motor_speed + delta);
     m_right_motor_speed = clip_speed(m_right_motor_speed + delta);
-    m_motors.setSpeeds(m_left_motor_speed, m_right_motor_speed);
+    m_spin_steering = false;
+    stage_motors();
 }
 
 void IRobot::change_speed_by(int16_t left_delta, int16_t right_delta)
 {
     m_left_motor_speed = clip_speed(m_left_motor_speed + left_delta);
     m_right_motor_speed = clip_speed(m_right_motor_speed + right_delta);
-    m_motors.setSpeeds(m_left_motor_speed, m_right_motor_speed);
+    m_spin_steering = false;
+    stage_motors();
 }
 
 void IRobot::move(int16_t speed)
 {
     m_left_motor_speed = m_right_motor_speed = clip_speed(speed);
-    m_motors.setSpeeds(m_left_motor_speed, m_right_motor_speed);
+    m_spin_steering = false;
+    stage_motors();
 }
 
 void IRobot::move(int16_t left_speed, int16_t right_speed)
 {
     m_left_motor_speed = clip_speed(left_speed);
     m_right_motor_speed = clip_speed(right_speed);
-    m_motors.setSpeeds(m_left_motor_speed, m_right_motor_speed);
+    m_spin_steering = false;
+    stage_motors();
 }
 
 void IRobot::stop()
 {
     m_left_motor_speed = m_right_motor_speed = 0;
-    m_motors.setSpeeds(m_left_motor_speed, m_right_motor_speed);
+    m_spin_steering = false;
+    stage_motors();
 }
 
 void IRobot::spin_left(int16_t degrees, int16_t speed)
 {
+    if (m_gyro_spins)
+    {
+        start_spin(degrees, speed);
+        return;
+    }
     m_left_motor_speed = clip_speed(-speed);
     m_right_motor_speed = clip_speed(speed);
-    m_encoder_count = degrees * m_encoder_counts_per_degree_rotation;
-    m_encoders.getCountsAndResetLeft();
-    m_motors.setSpeeds(m_left_motor_speed, m_right_motor_speed);
+    start_encoder_target(
+        SPIN_TARGET,
+        BOTH_WHEELS,
+        degrees * m_config.encoder_counts_per_degree
+    );
+    stage_motors();
 }
 
 void IRobot::spin_right(int16_t degrees, int16_t speed)
 {
+    if (m_gyro_spins)
+    {
+        start_spin(degrees, -speed);
+        return;
+    }
     m_left_motor_speed = clip_speed(speed);
     m_right_motor_speed = clip_speed(-speed);
-    m_encoder_count = degrees * m_encoder_counts_per_degree_rotation;
-    m_encoders.getCountsAndResetLeft();
-    m_motors.setSpeeds(m_left_motor_speed, m_right_motor_speed);
+    start_encoder_target(
+        SPIN_TARGET,
+        BOTH_WHEELS,
+        degrees * m_config.encoder_counts_per_degree
+    );
+    stage_motors();
+}
+
+void IRobot::set_gyro_spins(bool enabled)
+{
+    m_gyro_spins = enabled;
+}
+
+bool IRobot::gyro_spins() const
+{
+    return m_gyro_spins;
+}
+
+void IRobot::set_speed_control(bool enabled)
+{
+    m_speed_control = enabled;
+    m_speed_controller.restart();
+    m_motors_staged = true;
+}
+
+bool IRobot::speed_control() const
+{
+    return m_speed_control;
+}
+
+void IRobot::calibrate_motors()
+{
+    // Spin in place at each calibration command, let the wheels settle, then
+    // time the counts over a fixed window.
+    unsigned long const settle_ms = 200;
+    unsigned long const sample_ms = 250;
+    MotorCalibration calibration;
+
+    for (uint8_t i = 1; i < MotorCalibration::POINTS; ++i)
+    {
+        int16_t const command = i * MotorCalibration::STEP;
+        write_motors(command, -command);
+        delay(settle_ms);
+        m_left_counts += m_encoders.getCountsAndResetLeft();
+        m_right_counts += m_encoders.getCountsAndResetRight();
+        delay(sample_ms);
+        int16_t const left = m_encoders.getCountsAndResetLeft();
+        int16_t const right = m_encoders.getCountsAndResetRight();
+        m_left_counts += left;
+        m_right_counts += right;
+
+        calibration.left[i] = calibration_rate(
+            left * 1000L / sample_ms,
+            calibration.left[i - 1]
+        );
+        calibration.right[i] = calibration_rate(
+            -right * 1000L / sample_ms,
+            calibration.right[i - 1]
+        );
+    }
+
+    set_motor_calibration(calibration);
+    stop();
+    commit_motors();
+}
+
+bool IRobot::set_motor_calibration(MotorCalibration const & calibration)
+{
+    if (!m_speed_controller.set_calibration(calibration))
+    {
+        return false;
+    }
+
+    m_speed_control = true;
+    m_motors_staged = true;
+    return true;
 }
 
-void IRobot::cancel_encoder()
+MotorCalibration const & IRobot::motor_calibration() const
 {
-    m_encoder_count = 0;
+    return m_speed_controller.calibration();
+}
+
+SpeedController const & IRobot::speed_controller() const
+{
+    return m_speed_controller;
+}
+
+void IRobot::commit_motors()
+{
+    if (
+        m_left_motor_speed != m_left_committed_speed ||
+        m_right_motor_speed != m_right_committed_speed
+    )
+    {
+        m_left_committed_speed = m_left_motor_speed;
+        m_right_committed_speed = m_right_motor_speed;
+        m_motion_ms = millis();
+    }
+
+    if (!m_speed_control)
+    {
+        m_motors_staged = false;
+        write_motors(m_left_motor_speed, m_right_motor_speed);
+        return;
+    }
+
+    if (m_motors_staged)
+    {
+        m_motors_staged = false;
+        m_left_counts += m_encoders.getCountsAndResetLeft();
+        m_right_counts += m_encoders.getCountsAndResetRight();
+        m_speed_controller.set_target(
+            m_left_motor_speed,
+            m_right_motor_speed,
+            m_left_counts,
+            m_right_counts,
+            micros()
+        );
+    }
+    write_motors(
+        m_speed_controller.left_command(),
+        m_speed_controller.right_command()
+    );
+}
+
+unsigned long IRobot::motor_commands() const
+{
+    return m_motor_commands;
+}
+
+unsigned long IRobot::motor_writes() const
+{
+    return m_motor_writes;
+}
+
+void IRobot::start_encoder_target(
+    uint8_t target,
+    Wheel wheels,
+    uint16_t counts
+)
+{
+    // Bring the totals up to date, so the target starts from here.
+    m_left_counts += m_encoders.getCountsAndResetLeft();
+    m_right_counts += m_encoders.getCountsAndResetRight();
+    if (target == SPIN_TARGET)
+    {
+        m_spin_active = m_spin_steering = false;
+    }
+    m_encoder_targets.start(
+        target,
+        wheels,
+        counts,
+        m_left_counts,
+        m_right_counts
+    );
+}
+
+void IRobot::cancel_encoder(uint8_t target)
+{
+    if (target == SPIN_TARGET)
+    {
+        m_spin_active = m_spin_steering = false;
+    }
+    m_encoder_targets.cancel(target);
 }
 
 //
 // Private methods.
 //
-Boundary IRobot::boundary_detect()
+int16_t IRobot::calibration_rate(long measured, int16_t last)
 {
-    // below threshold => boundary.
-    // above threshold => ring.
-    const unsigned int threshold = 250;
+    if (last == 0 && measured <= 0)
+    {
+        return 0;
+    }
 
-    unsigned int sensor_values[3];
+    return measured > last ? measured : last + 1;
+}
+
+int16_t IRobot::clip_speed(int16_t speed) const
+{
+    int16_t const max_speed = m_config.max_speed;
+    int16_t const min_speed = -max_speed;
+
+    if (speed > max_speed)
+    {
+        speed = max_speed;
+    }
+    else if (speed < min_speed)
+    {
+        speed = min_speed;
+    }
+
+    return speed;
+}
+
+void IRobot::stage_motors()
+{
+    ++m_motor_commands;
+    m_motors_staged = true;
+}
+
+void IRobot::write_motors(int16_t left, int16_t right)
+{
+    if (left != m_left_motor_output || right != m_right_motor_output)
+    {
+        m_motors.setSpeeds(left, right);
+        m_left_motor_output = left;
+        m_right_motor_output = right;
+        ++m_motor_writes;
+    }
+}
+
+void IRobot::check_encoders()
+{
+    EventQueue & q = m_events;
+
+    if (m_sensors.start(ENCODER_SENSORS))
+    {
+        PROFILE_SCOPE(PROFILE_ENCODERS);
+        m_left_counts += m_encoders.getCountsAndResetLeft();
+        m_right_counts += m_encoders.getCountsAndResetRight();
+        m_sensors.finish(ENCODER_SENSORS);
+        if (m_speed_control)
+        {
+            // Corrections are written with the next commit.
+            m_speed_controller.update(m_left_counts, m_right_counts, micros());
+        }
+        m_encoder_targets.check(
+            m_left_counts,
+            m_right_counts,
+            [&q](uint8_t target) { q.push(EncoderEvent(target)); }
+        );
+    }
+}
+
+Boundary IRobot::boundary_detect()
+{
+    unsigned int sensor_values[LINE_SENSOR_COUNT];
     m_boundary_sensor.read(sensor_values);
-    bool left_boundary = sensor_values[0] < threshold;
-    bool center_boundary = sensor_values[1] < threshold;
-    bool right_boundary = sensor_values[2] < threshold;
 
-    Boundary boundary = NO_BOUNDARY;
-    if (center_boundary || (left_boundary && right_boundary))
+    return m_line_classifier.classify(sensor_values);
+}
+
+void IRobot::start_spin(int16_t degrees, int16_t speed)
+{
+    m_encoder_targets.cancel(SPIN_TARGET);
+    m_spin_active = m_spin_steering = true;
+    m_spin_speed = speed;
+
+    // Headings wrap every 4096 degrees, so only turns under 2048 degrees
+    // can be told from turns the other way.
+    if (degrees < 0)
     {
-        boundary = BOUNDARY_AHEAD;
+        degrees = 0;
     }
-    else if (left_boundary)
+    else if (degrees > SPIN_MAX_DEGREES)
     {
-        boundary = BOUNDARY_LEFT;
+        degrees = SPIN_MAX_DEGREES;
     }
-    else if (right_boundary)
+    int32_t const turn =
+        (speed < 0 ? -degrees : degrees) * GyroHeading::ONE_DEGREE;
+    m_spin_target = m_heading.heading() + static_cast<uint32_t>(turn);
+    m_left_motor_speed = clip_speed(-speed);
+    m_right_motor_speed = clip_speed(speed);
+    stage_motors();
+}
+
+void IRobot::steer_spin()
+{
+    // Heading still to turn, and the turn the robot makes in SPIN_LEAD_MS.
+    int32_t remaining =
+        static_cast<int32_t>(m_spin_target - m_heading.heading());
+    int32_t lead = static_cast<int32_t>(m_heading.rate()) * SPIN_LEAD_MS *
+        (GyroHeading::ONE_DEGREE / 1000);
+    if (m_spin_speed < 0)
     {
-        boundary = BOUNDARY_RIGHT;
+        remaining = -remaining;
+        lead = -lead;
     }
 
-    return boundary;
-}
\ No newline at end of file
+    if (remaining <= (lead > 0 ? lead : 0))
+    {
+        m_spin_active = m_spin_steering = false;
+        m_events.push(EncoderEvent(SPIN_TARGET));
+        return;
+    }
+    if (!m_spin_steering)
+    {
+        return;
+    }
+
+    // Slow down linearly over the last SPIN_SLOW_DEGREES, in 1/1024
+    // degrees.
+    int16_t const speed = m_spin_speed < 0 ? -m_spin_speed : m_spin_speed;
+    int32_t const slow = SPIN_SLOW_DEGREES * 1024L;
+    int32_t const to_go = remaining >> 10;
+    int16_t steered = speed;
+    if (to_go < slow && speed > SPIN_MIN_SPEED)
+    {
+        steered = SPIN_MIN_SPEED + (speed - SPIN_MIN_SPEED) * to_go / slow;
+    }
+    if (m_spin_speed < 0)
+    {
+        steered = -steered;
+    }
+
+    // Not a new motor command, so not counted as one.
+    int16_t const left_speed = clip_speed(-steered);
+    int16_t const right_speed = clip_speed(steered);
+    if (
+        left_speed != m_left_motor_speed ||
+        right_speed != m_right_motor_speed
+    )
+    {
+        m_left_motor_speed = left_speed;
+        m_right_motor_speed = right_speed;
+        m_motors_staged = true;
+    }
+}
@@ -8,16 +8,46 @@
 
 #include <Wire.h>
 #include <Zumo32U4.h>
+#include "boundaryclassifier.h"
+#include "contactdetector.h"
+#include "display.h"
+#include "encodertargets.h"
+#include "eventfilter.h"
 #include "eventqueue.h"
+#include "gyroheading.h"
+#include "imufifo.h"
+#include "proximitytracker.h"
+#include "robotconfig.h"
+#include "sensorscheduler.h"
+#include "speedcontroller.h"
+#include "timerwheel.h"
 
-// Return types for detect_boundary method.
-enum Boundary
-{
-    NO_BOUNDARY,
-    BOUNDARY_AHEAD,
-    BOUNDARY_LEFT,
-    BOUNDARY_RIGHT
-};
+// Line sensors used for boundary detection: 3 (DN1, DN3 and DN5) or all 5.
+// All five leave no pins for the side proximity sensors, so only the front
+// proximity sensor is used.
+#ifndef LINE_SENSOR_COUNT
+#define LINE_SENSOR_COUNT 3
+#endif
+
+// Gyro spins (see `IRobot::set_gyro_spins()`) slow down over the last
+// SPIN_SLOW_DEGREES of the turn, to no slower than SPIN_MIN_SPEED, and finish
+// when the heading is SPIN_LEAD_MS of turning short of the target. The lead
+// covers the robot's turn while the gyro samples wait to be read (about
+// 10 ms), and while it stops after the spin (about the motors' time
+// constant).
+#ifndef SPIN_SLOW_DEGREES
+#define SPIN_SLOW_DEGREES 90
+#endif
+
+#ifndef SPIN_MIN_SPEED
+#define SPIN_MIN_SPEED 60
+#endif
+
+#ifndef SPIN_LEAD_MS
+#define SPIN_LEAD_MS 50
+#endif
+
+typedef BoundaryClassifier<LINE_SENSOR_COUNT> LineClassifier;
 
 class IRobot
 {
@@ -26,17 +56,90 @@ public:
     void setup();
 
     // Call at the beginning of `loop()` to generate state machine events.
-    void generate_events(EventQueue & q);
+    void generate_events();
+
+    // Events generated for this robot's state machine, to be dispatched.
+    EventQueue & events();
+
+    // Set how often a repeating source (BOUNDARY_EVENT or PROXIMITY_EVENT)
+    // generates events while its reading persists. See `EventPolicy`. Call
+    // after `setup()`, which defaults both to LEVEL. Boundary events are only
+    // generated while a boundary is detected. Proximity events are also
+    // generated when the target is lost.
+    void set_event_policy(
+        RobotEvent source,
+        EventPolicy policy,
+        uint16_t period_ms = 0
+    );
+
+    // Number of events not generated because of event policies.
+    unsigned long suppressed_events() const;
+
+    // Read `source` every `period_us` (0 => every pass), starting `phase_us`
+    // from now. Slow sources are read at most one per pass. Call after
+    // `setup()`, which sets the defaults.
+    void set_sensor_schedule(
+        SensorSource source,
+        unsigned long period_us,
+        unsigned long phase_us,
+        bool slow
+    );
+
+    // Actual sample rates and read durations per sensor source.
+    SensorScheduler const & sensor_schedule() const;
     
-    // User feedback.
+    // User feedback. Shows `msg` on the LCD at the next `update_display()`.
     void display(char const * msg);
 
-    // Timer interfaces.
-    void cancel_timer();
-    void start_timer(unsigned long timeout_in_ms);
+    // Call at the end of `loop()` to copy display changes to the LCD, within
+    // a time budget. Takes several loops for a full screen change.
+    void update_display();
+
+    // Timer interfaces. Timers (see `RobotTimer`) run independently, and
+    // each expiration generates a `TimerEvent` naming its timer. Starting a
+    // running timer restarts it.
+    void cancel_timer(uint8_t timer = DEFAULT_TIMER);
+    void start_timer(
+        unsigned long timeout_in_ms,
+        uint8_t timer = DEFAULT_TIMER
+    );
+
+    // Per-sensor line sensor calibration (see `BoundaryClassifier`). Call
+    // `calibrate_line_sensors()` repeatedly while the sensors pass over both
+    // the ring and the border, e.g. spinning in place on the border. Save
+    // the result from `line_calibration()` and restore it with
+    // `set_line_calibration()` to skip this at start up.
+    void calibrate_line_sensors();
+    void reset_line_calibration();
+    void set_line_calibration(LineClassifier::Calibration const & calibration);
+    LineClassifier const & line_classifier() const;
 
-    // Motor interfaces.
-    // Note: motor speed is not linear!
+    // Opponent bearing and confidence as of the last proximity read, also
+    // carried by each `ProximityEvent`.
+    ProximityTracker const & proximity_tracker() const;
+
+    // Accelerometer samples read, and FIFO overruns. Each batch of samples
+    // is run through a `ContactDetector`, which raises `ContactEvent`s.
+    ImuFifo const & accelerometer() const;
+
+    // Heading integrated from the gyro, and gyro samples read.
+    GyroHeading const & heading() const;
+    ImuFifo const & gyro() const;
+
+    // Detection thresholds and motion constants. Takes effect from the next
+    // pass or motor command.
+    void set_config(RobotConfig const & config);
+    RobotConfig const & config() const;
+
+    // Motor interfaces. Speeds are clipped to `RobotConfig::max_speed`.
+    // Note: motor speed is not linear in the motor command! With speed
+    // control on (see `set_speed_control()`), speeds are wheel speeds, linear
+    // and matched between the wheels.
+    //
+    // Commands are staged, and written by `commit_motors()`, so a dispatch
+    // that changes speed several times (e.g. `stop()` in one state's
+    // `on_exit()`, then `move()` in the next one's `on_entry()`) makes at
+    // most one motor write, of the last command.
     void change_speed_by(int16_t delta);
     void change_speed_by(int16_t left_delta, int16_t right_delta);
     void move(int16_t speed);
@@ -44,49 +147,81 @@ public:
     void stop();
     void spin_left(int16_t degrees, int16_t speed);
     void spin_right(int16_t degrees, int16_t speed);
-    void cancel_encoder();
+
+    // Whether `spin_left()` and `spin_right()` turn by the gyro heading (on
+    // after `setup()`), or by encoder counts (see
+    // `RobotConfig::encoder_counts_per_degree`). A gyro spin slows down as
+    // it nears the target, and finishes with an `EncoderEvent` for
+    // SPIN_TARGET, as an encoder spin does, but tread slip does not cut it
+    // short. Any other motor command ends the slow down, but not the spin.
+    // Gyro spins turn at most 2047 degrees.
+    void set_gyro_spins(bool enabled);
+    bool gyro_spins() const;
+
+    // Call in `loop()` after dispatching events, to write the staged motor
+    // command and any speed control correction. Writes only if the motor
+    // outputs change.
+    void commit_motors();
+
+    // Motor commands issued, and motor writes made.
+    unsigned long motor_commands() const;
+    unsigned long motor_writes() const;
+
+    // Closed-loop wheel speed control (see `SpeedController`). Off after
+    // `setup()`: motor speeds are written as motor commands.
+    void set_speed_control(bool enabled);
+    bool speed_control() const;
+
+    // Measure each wheel's speed across the range of motor commands, and use
+    // the measurements for speed control, unless a wheel never turned. Spins
+    // in place for about four seconds, blocking. Save the result from
+    // `motor_calibration()` and restore it with `set_motor_calibration()` to
+    // skip this at start up. `set_motor_calibration()` returns `false`,
+    // changing nothing, if the calibration is not as `MotorCalibration`
+    // describes.
+    void calibrate_motors();
+    bool set_motor_calibration(MotorCalibration const & calibration);
+    MotorCalibration const & motor_calibration() const;
+    SpeedController const & speed_controller() const;
+
+    // Encoder targets (see `RobotEncoderTarget`) run independently, and each
+    // completion generates an `EncoderEvent` naming its target. `spin_left()`
+    // and `spin_right()` use SPIN_TARGET. Starting an active target restarts
+    // it.
+    void start_encoder_target(uint8_t target, Wheel wheels, uint16_t counts);
+    void cancel_encoder(uint8_t target = SPIN_TARGET);
 
 private:
-    // Change the following value to match the gear ratio of your Zumo.
-    // The formula derivation is as follows:
-    //
-    // The circumference of the circle enscribed by a robot spinning in place
-    // (one tread going forward, one tread going backwards at the same speed)
-    // is
-    //    Cr = r * pi
-    // 
-    // The distance travelled in one wheel rotation is
-    //    Cw = w * pi
-    //
-    // The number of encoder counts per wheel revolution is
-    //    Ew = g * e
-    //
-    // The number of encoder counts in 1 degree of robot rotation is
-    //    Er = ((Cr / Cw) * Ew) / 360
-    //    
-    // Where
-    //    g = gear ratio of the Zumo.
-    //        (ie 50 for 50:1, 75 for 75:1, 100 for 100:1)
-    //    e = encoder counts / motor revolution.
-    //        This is 12, per the documentation.
-    //    r = robot width, center of tread to center of tread.
-    //        Measured to be 88 mm.
-    //    w = diameter of wheel, with tread attached.
-    //        Measured to be 38 mm.
-    //
-    // Motor Gearing  Encoder counts per degree rotation 
-    // =============  ================================== 
-    //          50:1  4                                  
-    //          75:1  6                                  
-    //         100:1  8                                  
-    int16_t const m_encoder_counts_per_degree_rotation = 4;
+    // Most time `update_display()` may spend on LCD writes per loop.
+    uint16_t const m_display_budget_us = 200;
 
     Boundary boundary_detect();
 
+    // Calibration table entry for a `measured` wheel speed, after `last`:
+    // 0 in the deadband, then always above `last`, as `SpeedController`
+    // requires.
+    static int16_t calibration_rate(long measured, int16_t last);
+
+    int16_t clip_speed(int16_t speed) const;
+
+    // Stage the motor speeds for the next `commit_motors()`.
+    void stage_motors();
+
+    // Write `left`, `right` to the motors, if they changed.
+    void write_motors(int16_t left, int16_t right);
+
+    // Update encoder totals, and generate events for completed targets.
+    void check_encoders();
+
+    // Start a gyro spin of `degrees` at `speed` (positive => left), or
+    // steer the active one after a heading update.
+    void start_spin(int16_t degrees, int16_t speed);
+    void steer_spin();
+
     // Robot I/O interfaces. Uncomment those used. Comment out those not used.
     // Also check IRobot::setup() for calls to `init()` functions to be
     // enabled/disabled.
-//    L3G m_gyro;
+    L3G m_gyro;
     LSM303 m_accelerometer;
 //    Zumo32U4ButtonA m_a_button;
     Zumo32U4ButtonB m_start_button;
@@ -94,18 +229,77 @@ private:
 //    Zumo32U4Buzzer m_buzzer;
     Zumo32U4Encoders m_encoders;
 //    Zumo32U4IRPulses m_ir_emitters;
-    Zumo32U4LCD m_lcd;
+    Display m_display;
     Zumo32U4LineSensors m_boundary_sensor;
     Zumo32U4Motors m_motors;
     Zumo32U4ProximitySensors m_proximity_sensors;
 
-    // Timer "register". Use `start_timer()` to set, `cancel_timer()` to clear.
-    unsigned long m_end_time;
+    RobotConfig m_config;
+
+    // Generated events.
+    EventQueue m_events;
+
+    // Sensor read schedule.
+    SensorScheduler m_sensors;
+
+    // Line sensor thresholds and boundary directions.
+    LineClassifier m_line_classifier;
+
+    // Opponent bearing from the proximity sensors.
+    ProximityTracker m_proximity;
+
+    // Accelerometer samples, and collisions and pushes in them.
+    ImuFifo m_accelerometer_fifo;
+    ContactDetector m_contact_detector;
+
+    // Gyro samples, and the heading integrated from them, and encoder
+    // totals at the last gyro read, to tell when the robot is still.
+    ImuFifo m_gyro_fifo;
+    GyroHeading m_heading;
+    int32_t m_gyro_left_counts;
+    int32_t m_gyro_right_counts;
+
+    // Gyro spins: whether spins use the gyro, whether one is active and
+    // whether it is still steering the motors, its target heading, and its
+    // speed (positive => left). Turns are cut to SPIN_MAX_DEGREES, the most
+    // a heading difference can hold.
+    static int16_t const SPIN_MAX_DEGREES = 2047;
+    bool m_gyro_spins;
+    bool m_spin_active;
+    bool m_spin_steering;
+    uint32_t m_spin_target;
+    int16_t m_spin_speed;
+
+    // Event policies for repeating sources.
+    EventFilter m_boundary_filter;
+    EventFilter m_proximity_filter;
+
+    // Timers. Use `start_timer()` to set, `cancel_timer()` to clear.
+    TimerWheel<TIMER_COUNT, 16> m_timers;
     
-    // Encoder "register". Use `spin_left()` or `spin_right()` to set.
-    int16_t m_encoder_count;
+    // Running encoder totals, and targets against them. Use
+    // `start_encoder_target()`, `spin_left()` or `spin_right()` to set.
+    int32_t m_left_counts;
+    int32_t m_right_counts;
+    EncoderTargets<ENCODER_TARGET_COUNT> m_encoder_targets;
 
     // Motor speeds.
     int16_t m_left_motor_speed;
     int16_t m_right_motor_speed;
+
+    // Wheel speed control, when on.
+    SpeedController m_speed_controller;
+    bool m_speed_control;
+
+    // Last committed command, and millis() when it last changed.
+    int16_t m_left_committed_speed;
+    int16_t m_right_committed_speed;
+    unsigned long m_motion_ms;
+
+    // Staged command, last motor write, and counters.
+    bool m_motors_staged;
+    int16_t m_left_motor_output;
+    int16_t m_right_motor_output;
+    unsigned long m_motor_commands;
+    unsigned long m_motor_writes;
 };
\ No newline at end of file
@@ -0,0 +1,112 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Compile-time defaults for `RobotConfig`. Override them in the build flags,
+// e.g. `-DCONFIG_BOUNDARY_THRESHOLD=400`, or replace the robot's configuration
+// at runtime with `IRobot::set_config()`.
+#ifndef CONFIG_BOUNDARY_THRESHOLD
+#define CONFIG_BOUNDARY_THRESHOLD 250
+#endif
+
+#ifndef CONFIG_BOUNDARY_FRACTION
+#define CONFIG_BOUNDARY_FRACTION 20
+#endif
+
+#ifndef CONFIG_PROXIMITY_THRESHOLD
+#define CONFIG_PROXIMITY_THRESHOLD 1
+#endif
+
+#ifndef CONFIG_COLLISION_THRESHOLD
+#define CONFIG_COLLISION_THRESHOLD 1500
+#endif
+
+#ifndef CONFIG_PUSH_THRESHOLD
+#define CONFIG_PUSH_THRESHOLD 250
+#endif
+
+#ifndef CONFIG_MAX_SPEED
+#define CONFIG_MAX_SPEED 400
+#endif
+
+#ifndef CONFIG_ENCODER_COUNTS_PER_DEGREE
+#define CONFIG_ENCODER_COUNTS_PER_DEGREE 4
+#endif
+
+// Detection thresholds and motion constants used by `IRobot`.
+struct RobotConfig
+{
+    RobotConfig() :
+        boundary_threshold(CONFIG_BOUNDARY_THRESHOLD),
+        boundary_fraction(CONFIG_BOUNDARY_FRACTION),
+        proximity_threshold(CONFIG_PROXIMITY_THRESHOLD),
+        collision_threshold(CONFIG_COLLISION_THRESHOLD),
+        push_threshold(CONFIG_PUSH_THRESHOLD),
+        max_speed(CONFIG_MAX_SPEED),
+        encoder_counts_per_degree(CONFIG_ENCODER_COUNTS_PER_DEGREE)
+    {}
+
+    // Line sensor reading below which a sensor is over the boundary (white).
+    // Readings are reflectance decay times in microseconds, up to 2000.
+    uint16_t boundary_threshold;
+
+    // For calibrated line sensors (see `IRobot::calibrate_line_sensors()`),
+    // the threshold instead sits this many 256ths of the way from the
+    // sensor's lowest to its highest calibration reading. The default
+    // matches `boundary_threshold` on a sensor reading 100 to 2000.
+    uint8_t boundary_fraction;
+
+    // Lowest front proximity brightness count (0 through 6) reported as a
+    // detection.
+    uint8_t proximity_threshold;
+
+    // Horizontal acceleration, in thousandths of g, reported as a collision
+    // (a sudden change) or a push (held, see `ContactDetector`). The robot's
+    // own hardest starts and stops should stay below the collision
+    // threshold.
+    uint16_t collision_threshold;
+    uint16_t push_threshold;
+
+    // Largest motor speed magnitude, up to 400.
+    int16_t max_speed;
+
+    // Change the following value to match the gear ratio of your Zumo.
+    // The formula derivation is as follows:
+    //
+    // The circumference of the circle enscribed by a robot spinning in place
+    // (one tread going forward, one tread going backwards at the same speed)
+    // is
+    //    Cr = r * pi
+    //
+    // The distance travelled in one wheel rotation is
+    //    Cw = w * pi
+    //
+    // The number of encoder counts per wheel revolution is
+    //    Ew = g * e
+    //
+    // The number of encoder counts in 1 degree of robot rotation is
+    //    Er = ((Cr / Cw) * Ew) / 360
+    //
+    // Where
+    //    g = gear ratio of the Zumo.
+    //        (ie 50 for 50:1, 75 for 75:1, 100 for 100:1)
+    //    e = encoder counts / motor revolution.
+    //        This is 12, per the documentation.
+    //    r = robot width, center of tread to center of tread.
+    //        Measured to be 88 mm.
+    //    w = diameter of wheel, with tread attached.
+    //        Measured to be 38 mm.
+    //
+    // Motor Gearing  Encoder counts per degree rotation
+    // =============  ==================================
+    //          50:1  4
+    //          75:1  6
+    //         100:1  8
+    int16_t encoder_counts_per_degree;
+};
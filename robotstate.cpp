@@ -5,69 +5,33 @@
     LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
  */
 #include "robotstate.h"
+#include "robotstatemachine.h"
+#include "trace.h"
 
 using namespace statemachine;
 
-RobotState::RobotState(char const * name, State * parent, IRobot & robot) :
-    State(name, parent), m_robot(robot)
+RobotState::RobotState(
+    char const * name,
+    State * parent,
+    IRobot & robot,
+    uint16_t handled_events
+) :
+    State(name, parent, handled_events), m_robot(robot)
 {
 }
 
-Result RobotState::transition_to_state(State & state)
-{
-    Result r = State::transition_to_state(state);
-    m_robot.display(active_state_name());
-
-    return r;
-}
-bool RobotState::on_event(Event & event)
+RobotStateMachine & RobotState::machine()
 {
-    bool handled = false;
-
-    switch(event.m_id)
-    {
-        case BOUNDARY_EVENT:
-            handled = on_event(static_cast<BoundaryEvent &>(event));
-            break;
-        case ENCODER_EVENT:
-            handled = on_event(static_cast<EncoderEvent &>(event));
-            break;
-        case PROXIMITY_EVENT:
-            handled = on_event(static_cast<ProximityEvent &>(event));
-            break;
-        case START_EVENT:
-            handled = on_event(static_cast<StartButtonEvent &>(event));
-            break;
-        case TIMER_EVENT:
-            handled = on_event(static_cast<TimerEvent &>(event));
-            break;
-        default:
-            break;
-    }
-    return handled;
+    return *static_cast<RobotStateMachine *>(root_state());
 }
 
-bool RobotState::on_event(BoundaryEvent & event)
-{ 
-    return false; 
-}
-
-bool RobotState::on_event(EncoderEvent & event)
-{
-    return false;
-}
-
-bool RobotState::on_event(ProximityEvent & event)
-{
-    return false;
-}
-
-bool RobotState::on_event(StartButtonEvent & event)
+Result RobotState::transition_to_state(State & state)
 {
-    return false; 
-}
+    TRACE_TRANSITION(active_state()->index(), state.index());
+    Result r = State::transition_to_state(state);
+    char name[Display::WIDTH + 1];
+    read_name(active_state_name(), name, sizeof(name));
+    m_robot.display(name);
 
-bool RobotState::on_event(TimerEvent & event)
-{ 
-    return false; 
+    return r;
 }
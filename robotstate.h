@@ -12,19 +12,101 @@
 
 using namespace statemachine;
 
+class RobotStateMachine;
+
 class RobotState : public State
 {
 public:
-    RobotState(char const * name, State * parent, IRobot & robot);
+    RobotState(
+        char const * name,
+        State * parent,
+        IRobot & robot,
+        uint16_t handled_events = ALL_EVENTS
+    );
     Result transition_to_state(State & state) override;
 
 protected:
-    bool on_event(Event & event) override;
-    virtual bool on_event(BoundaryEvent & event);
-    virtual bool on_event(EncoderEvent & event);
-    virtual bool on_event(ProximityEvent & event);
-    virtual bool on_event(StartButtonEvent & event);
-    virtual bool on_event(TimerEvent & event);
-    
+    // Machine this state belongs to, for reaching other states.
+    RobotStateMachine & machine();
+
     IRobot & m_robot;
-};
\ No newline at end of file
+};
+
+// Type list tag used by `RobotStateT` dispatch.
+template <typename... Events>
+struct Handles
+{};
+
+// Mask of handled event bits for a list of event classes.
+template <typename... Events>
+struct HandledEventMask;
+
+template <>
+struct HandledEventMask<>
+{
+    static uint16_t const VALUE = 0;
+};
+
+template <typename E, typename... Rest>
+struct HandledEventMask<E, Rest...>
+{
+    static uint16_t const VALUE =
+        (1u << E::ID) | HandledEventMask<Rest...>::VALUE;
+};
+
+// Base class for robot states, with event dispatch generated at compile time.
+//
+// Derive as
+//
+//     class MyState : public RobotStateT<MyState, TimerEvent, BoundaryEvent>
+//     {
+//         friend RobotStateT;
+//         ...
+//     protected:
+//         bool on_event(TimerEvent & event);
+//         bool on_event(BoundaryEvent & event);
+//     };
+//
+// listing every event class `MyState` handles, with a (non-virtual) handler
+// for each. A listed event without a handler is a compile error. The list becomes the state's handled events mask, so the machine
+// passes other events straight to the first parent that handles them, and
+// dispatches listed events to their handler through an unrolled comparison of
+// event ids, rather than a switch and a virtual call per event class.
+template <typename Derived, typename... Events>
+class RobotStateT : public RobotState
+{
+public:
+    RobotStateT(char const * name, State * parent, IRobot & robot) :
+        RobotState(name, parent, robot, HandledEventMask<Events...>::VALUE)
+    {}
+
+protected:
+    bool on_event(Event & event) override
+    {
+        return dispatch(event, Handles<Events...>());
+    }
+
+private:
+    bool dispatch(Event & event, Handles<>)
+    {
+        return false;
+    }
+
+    template <typename E, typename... Rest>
+    bool dispatch(Event & event, Handles<E, Rest...>)
+    {
+        if (event.m_id == E::ID)
+        {
+            // Taking the handler's address, rather than calling
+            // `on_event()` by name, fails to compile if `Derived` has no
+            // `on_event(E &)`, instead of falling back to the virtual
+            // `on_event(Event &)` and recursing forever.
+            bool (Derived::*handler)(E &) = &Derived::on_event;
+            return (static_cast<Derived *>(this)->*handler)(
+                static_cast<E &>(event)
+            );
+        }
+
+        return dispatch(event, Handles<Rest...>());
+    }
+};
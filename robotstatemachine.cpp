@@ -4,16 +4,30 @@
     This source code is released under the 3-Clause BSD license. See 
     LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
  */
-#include "initstate.h"
+#include "profiler.h"
 #include "robotstatemachine.h"
 
-extern InitState initialized;
-
-RobotStateMachine::RobotStateMachine(State * parent, IRobot & robot) :
-    RobotState("machine", parent, robot)
-{}
+RobotStateMachine::RobotStateMachine(IRobot & robot) :
+    RobotStateT(STATEMACHINE_NAME("machine"), nullptr, robot),
+    m_initialized(this, robot),
+    m_standby(this, robot),
+    m_table()
+{
+    m_states[0] = this;
+    m_states[1] = &m_initialized;
+    m_states[2] = &m_standby;
+    freeze(m_states, STATE_COUNT, m_common_parents);
+#ifdef PROFILING
+    m_table.hook = &profiler;
+#endif
+}
 
 Result RobotStateMachine::on_initialize()
 {
-    return transition_to_state(initialized);
-}
\ No newline at end of file
+    return transition_to_state(m_initialized);
+}
+
+State::Table * RobotStateMachine::table()
+{
+    return &m_table;
+}
@@ -6,13 +6,40 @@
  */
 #pragma once
 
+#include "initstate.h"
 #include "robotstate.h"
+#include "standbystate.h"
 
-class RobotStateMachine : public RobotState
+// Root of the robot's state machine. Owns every other state, so each machine
+// is independent of any other, and states reach their transition targets
+// through `machine()`. Add new states as members, and to `m_states`.
+class RobotStateMachine : public RobotStateT<RobotStateMachine>
 {
 public:
-    RobotStateMachine(State * parent, IRobot & robot);
+    explicit RobotStateMachine(IRobot & robot);
+
+    RobotStateMachine(RobotStateMachine const &) = delete;
+    RobotStateMachine & operator=(RobotStateMachine const &) = delete;
+
+    InitState & initialized() { return m_initialized; }
+    StandbyState & standby() { return m_standby; }
 
 protected:
     Result on_initialize() override;
+    Table * table() override;
+
+private:
+    static uint8_t const STATE_COUNT = 3;
+
+    InitState m_initialized;
+    StandbyState m_standby;
+
+    // Every state in the machine, and the common parent of every pair, for
+    // precomputing transition paths.
+    State * m_states[STATE_COUNT];
+    uint8_t m_common_parents[STATE_COUNT * STATE_COUNT];
+
+    // The frozen state table and active leaf, kept here rather than in every
+    // state.
+    Table m_table;
 };
@@ -0,0 +1,138 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include <Arduino.h>
+#include "sensorscheduler.h"
+
+SensorScheduler::SensorScheduler() :
+    m_pass_us(0),
+    m_read_start_us(0),
+    m_slow_source(SENSOR_COUNT),
+    m_stats_end_us(0),
+    m_stats_us(0)
+{
+    for (Source & s : m_sources)
+    {
+        s.period_us = 0;
+        s.next_us = 0;
+        s.samples = 0;
+        s.total_read_us = 0;
+        s.max_read_us = 0;
+        s.slow = false;
+    }
+}
+
+void SensorScheduler::set_schedule(
+    uint8_t source,
+    unsigned long period_us,
+    unsigned long phase_us,
+    bool slow,
+    unsigned long now_us
+)
+{
+    Source & s = m_sources[source];
+    s.period_us = period_us;
+    s.next_us = now_us + phase_us;
+    s.slow = slow;
+}
+
+void SensorScheduler::begin_pass(unsigned long now_us)
+{
+    m_pass_us = now_us;
+
+    // Pick the most overdue slow source, if any are due.
+    m_slow_source = SENSOR_COUNT;
+    unsigned long most_overdue_us = 0;
+    for (uint8_t i = 0; i < SENSOR_COUNT; ++i)
+    {
+        Source const & s = m_sources[i];
+        if (s.slow && reached(now_us, s.next_us))
+        {
+            unsigned long const overdue_us = now_us - s.next_us;
+            if (m_slow_source == SENSOR_COUNT || overdue_us > most_overdue_us)
+            {
+                m_slow_source = i;
+                most_overdue_us = overdue_us;
+            }
+        }
+    }
+}
+
+bool SensorScheduler::start(uint8_t source)
+{
+    Source & s = m_sources[source];
+    if (s.slow ? source != m_slow_source : !reached(m_pass_us, s.next_us))
+    {
+        return false;
+    }
+
+    // Keep to the phase, unless a whole period has been missed.
+    s.next_us += s.period_us;
+    if (reached(m_pass_us, s.next_us))
+    {
+        s.next_us = m_pass_us + s.period_us;
+    }
+
+    m_read_start_us = micros();
+    return true;
+}
+
+void SensorScheduler::finish(uint8_t source)
+{
+    Source & s = m_sources[source];
+    unsigned long const now_us = micros();
+    unsigned long const read_us = now_us - m_read_start_us;
+
+    // Elapsed time is summed a read at a time, so it survives micros()
+    // wrapping every 71 minutes.
+    m_stats_us += now_us - m_stats_end_us;
+    m_stats_end_us = now_us;
+
+    ++s.samples;
+    s.total_read_us += read_us;
+    if (read_us > s.max_read_us)
+    {
+        s.max_read_us = read_us > 0xFFFF ? 0xFFFF : read_us;
+    }
+}
+
+unsigned long SensorScheduler::samples(uint8_t source) const
+{
+    return m_sources[source].samples;
+}
+
+unsigned long SensorScheduler::mean_read_us(uint8_t source) const
+{
+    Source const & s = m_sources[source];
+    return s.samples ? s.total_read_us / s.samples : 0;
+}
+
+unsigned long SensorScheduler::max_read_us(uint8_t source) const
+{
+    return m_sources[source].max_read_us;
+}
+
+unsigned long SensorScheduler::sample_rate(uint8_t source) const
+{
+    // In 64 bits: samples * 1000000 overflows 32 after 4295 reads.
+    return m_stats_us ?
+        static_cast<unsigned long>(
+            m_sources[source].samples * 1000000ULL / m_stats_us
+        ) :
+        0;
+}
+
+void SensorScheduler::reset_stats(unsigned long now_us)
+{
+    for (Source & s : m_sources)
+    {
+        s.samples = 0;
+        s.total_read_us = 0;
+        s.max_read_us = 0;
+    }
+    m_stats_end_us = now_us;
+    m_stats_us = 0;
+}
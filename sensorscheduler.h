@@ -0,0 +1,89 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Sensor sources read by `IRobot::generate_events()`.
+enum SensorSource : uint8_t
+{
+    START_BUTTON_SENSOR,
+    LINE_SENSORS,
+    ENCODER_SENSORS,
+    PROXIMITY_SENSORS,
+    ACCELEROMETER_SENSOR,
+    GYRO_SENSOR,
+    SENSOR_COUNT
+};
+
+// Decides which sensor sources to read on each pass of `generate_events()`,
+// and keeps per-source read statistics.
+//
+// Each source is read every `period_us`, offset by `phase_us`. A period of 0
+// reads the source on every pass. Sources marked slow are interleaved: at most
+// one slow source is read per pass, the most overdue first, so no single pass
+// pays for all of them.
+class SensorScheduler
+{
+public:
+    SensorScheduler();
+
+    // Set the read schedule of `source`, starting from `now_us`.
+    void set_schedule(
+        uint8_t source,
+        unsigned long period_us,
+        unsigned long phase_us,
+        bool slow,
+        unsigned long now_us
+    );
+
+    // Call at the start of each pass, before any `start()`.
+    void begin_pass(unsigned long now_us);
+
+    // Returns `true` if `source` should be read now. If so, call `finish()`
+    // when the read is done.
+    bool start(uint8_t source);
+    void finish(uint8_t source);
+
+    // Statistics since the last `reset_stats()`.
+    unsigned long samples(uint8_t source) const;
+    unsigned long mean_read_us(uint8_t source) const;
+    unsigned long max_read_us(uint8_t source) const;
+    // Reads per second.
+    unsigned long sample_rate(uint8_t source) const;
+    void reset_stats(unsigned long now_us);
+
+private:
+    struct Source
+    {
+        unsigned long period_us;
+        unsigned long next_us;
+        unsigned long samples;
+        unsigned long total_read_us;
+        uint16_t max_read_us;
+        bool slow;
+    };
+
+    // `true` if `t` is at or after `deadline`, across micros() wraparound.
+    static bool reached(unsigned long t, unsigned long deadline)
+    {
+        return static_cast<long>(t - deadline) >= 0;
+    }
+
+    Source m_sources[SENSOR_COUNT];
+
+    // Start of the current pass, and of the current read.
+    unsigned long m_pass_us;
+    unsigned long m_read_start_us;
+
+    // Slow source picked for this pass, or SENSOR_COUNT.
+    uint8_t m_slow_source;
+
+    // End of the last read, and time since `reset_stats()` to it.
+    unsigned long m_stats_end_us;
+    uint64_t m_stats_us;
+};
@@ -0,0 +1,249 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include "speedcontroller.h"
+
+// Largest integral term, as a command in 1/256ths.
+static int32_t const INTEGRAL_LIMIT = 400L * 256;
+
+SpeedController::SpeedController() :
+    m_last_us(0),
+    m_restart(true)
+{
+    m_left = m_right = WheelControl{0, 0, 0, 0, 0, 0};
+    set_calibration(m_calibration);
+}
+
+bool SpeedController::set_calibration(MotorCalibration const & calibration)
+{
+    if (!valid(calibration.left) || !valid(calibration.right))
+    {
+        return false;
+    }
+
+    m_calibration = calibration;
+    m_restart = true;
+
+    uint8_t const last = MotorCalibration::POINTS - 1;
+    int16_t const left = m_calibration.left[last];
+    int16_t const right = m_calibration.right[last];
+    m_top_rate = left < right ? left : right;
+    if (m_top_rate < 1)
+    {
+        m_top_rate = 1;
+    }
+
+    return true;
+}
+
+MotorCalibration const & SpeedController::calibration() const
+{
+    return m_calibration;
+}
+
+void SpeedController::restart()
+{
+    m_restart = true;
+}
+
+void SpeedController::set_target(
+    int16_t left,
+    int16_t right,
+    int32_t left_counts,
+    int32_t right_counts,
+    unsigned long now_us
+)
+{
+    // A state may ask for the same speeds every loop. Restarting the
+    // measurement each time would keep `update()` from ever running, so
+    // only a new target restarts it.
+    if (
+        !m_restart &&
+        target_rate(left) == m_left.target &&
+        target_rate(right) == m_right.target
+    )
+    {
+        return;
+    }
+    m_restart = false;
+
+    set_wheel(m_left, m_calibration.left, left, left_counts);
+    set_wheel(m_right, m_calibration.right, right, right_counts);
+    m_last_us = now_us;
+}
+
+bool SpeedController::update(
+    int32_t left_counts,
+    int32_t right_counts,
+    unsigned long now_us
+)
+{
+    uint32_t const dt_us = now_us - m_last_us;
+    if (dt_us < SPEED_CONTROL_PERIOD_US)
+    {
+        return false;
+    }
+    m_last_us = now_us;
+
+    bool changed =
+        update_wheel(m_left, m_calibration.left, left_counts, dt_us);
+    changed |= update_wheel(m_right, m_calibration.right, right_counts, dt_us);
+
+    return changed;
+}
+
+int16_t SpeedController::left_command() const
+{
+    return m_left.command;
+}
+
+int16_t SpeedController::right_command() const
+{
+    return m_right.command;
+}
+
+int32_t SpeedController::left_rate() const
+{
+    return m_left.rate;
+}
+
+int32_t SpeedController::right_rate() const
+{
+    return m_right.rate;
+}
+
+//
+// Private methods.
+//
+
+int32_t SpeedController::target_rate(int16_t speed) const
+{
+    return static_cast<int32_t>(speed) * m_top_rate / 400;
+}
+
+// `command_for()` divides by the rise between neighbouring entries, so after
+// the deadband every entry must be above the one before.
+bool SpeedController::valid(int16_t const * rates)
+{
+    if (rates[0] != 0)
+    {
+        return false;
+    }
+    for (uint8_t i = 1; i < MotorCalibration::POINTS; ++i)
+    {
+        if (rates[i] <= rates[i - 1] && !(rates[i] == 0 && rates[i - 1] == 0))
+        {
+            return false;
+        }
+    }
+
+    // A wheel that never turns cannot be controlled.
+    return rates[MotorCalibration::POINTS - 1] > 0;
+}
+
+// Interpolate the command that turns a wheel at `rate`, from its calibration.
+// Rates below the first nonzero entry (the deadband) map to commands in the
+// first step that moves the wheel.
+int16_t SpeedController::command_for(int16_t const * rates, int32_t rate)
+{
+    int32_t const magnitude = rate < 0 ? -rate : rate;
+    uint8_t const last = MotorCalibration::POINTS - 1;
+    int16_t const step = MotorCalibration::STEP;
+    int16_t command;
+
+    if (magnitude == 0)
+    {
+        return 0;
+    }
+    if (magnitude >= rates[last])
+    {
+        command = last * step;
+    }
+    else
+    {
+        uint8_t i = last - 1;
+        while (i > 0 && rates[i] > magnitude)
+        {
+            --i;
+        }
+        int32_t const span = rates[i + 1] - rates[i];
+        command = i * step + (magnitude - rates[i]) * step / span;
+    }
+
+    return rate < 0 ? -command : command;
+}
+
+void SpeedController::set_wheel(
+    WheelControl & wheel,
+    int16_t const * rates,
+    int16_t speed,
+    int32_t counts
+)
+{
+    int32_t const target = target_rate(speed);
+
+    // The integral holds the correction for this wheel's drift from its
+    // calibration, so keep it while driving the same way.
+    if (target == 0 || (target < 0) != (wheel.target < 0))
+    {
+        wheel.integral = 0;
+    }
+    wheel.target = target;
+    wheel.last_counts = counts;
+    wheel.feedforward = command_for(rates, target);
+
+    int32_t command = wheel.feedforward + wheel.integral / 256;
+    if (target == 0)
+    {
+        command = 0;
+    }
+    wheel.command = command > 400 ? 400 : command < -400 ? -400 : command;
+}
+
+bool SpeedController::update_wheel(
+    WheelControl & wheel,
+    int16_t const * rates,
+    int32_t counts,
+    uint32_t dt_us
+)
+{
+    // Counts per second, from the time in 16 us units so the product stays
+    // within 32 bits.
+    int32_t const delta = counts - wheel.last_counts;
+    wheel.last_counts = counts;
+    wheel.rate = delta * 62500L / static_cast<int32_t>(dt_us >> 4);
+
+    int16_t const old = wheel.command;
+    if (wheel.target == 0)
+    {
+        wheel.command = 0;
+        return wheel.command != old;
+    }
+
+    int32_t const error =
+        wheel.feedforward - command_for(rates, wheel.rate);
+    int32_t const integral = wheel.integral + SPEED_KI * error;
+    int32_t command =
+        wheel.feedforward + (SPEED_KP * error + integral) / 256;
+
+    // Only integrate while the command is in range, so the integral does not
+    // wind up while the wheel cannot keep up.
+    if (command > 400)
+    {
+        command = 400;
+    }
+    else if (command < -400)
+    {
+        command = -400;
+    }
+    else if (integral > -INTEGRAL_LIMIT && integral < INTEGRAL_LIMIT)
+    {
+        wheel.integral = integral;
+    }
+    wheel.command = command;
+
+    return wheel.command != old;
+}
@@ -0,0 +1,146 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Controller timing and gains. Gains are in 1/256ths, on the speed error
+// expressed as a motor command (see `SpeedController`). Override them in the
+// build flags.
+#ifndef SPEED_CONTROL_PERIOD_US
+#define SPEED_CONTROL_PERIOD_US 10000
+#endif
+
+#ifndef SPEED_KP
+#define SPEED_KP 192
+#endif
+
+#ifndef SPEED_KI
+#define SPEED_KI 48
+#endif
+
+// Measured wheel speed, in encoder counts per second, at motor commands 0,
+// `STEP`, 2 * `STEP`, ... 400, for each wheel. Each table starts at 0, may
+// stay at 0 through the deadband, then strictly increases. Build one with
+// `IRobot::calibrate_motors()`. The default is a linear 75:1 Zumo (about 5000
+// counts per second at full speed), matching the simulator.
+struct MotorCalibration
+{
+    static uint8_t const POINTS = 9;
+    static int16_t const STEP = 400 / (POINTS - 1);
+
+    MotorCalibration()
+    {
+        for (uint8_t i = 0; i < POINTS; ++i)
+        {
+            left[i] = right[i] = i * 625;
+        }
+    }
+
+    int16_t left[POINTS];
+    int16_t right[POINTS];
+};
+
+// Closed-loop wheel speed control.
+//
+// Speeds are in motor speed units (-400 through 400), but linear: speed 400
+// is the full speed of the slower wheel, and half of it is half that wheel
+// speed, on both wheels. The calibration table turns each requested speed
+// into a feedforward motor command, so the wheels are close from the first
+// write. Every `SPEED_CONTROL_PERIOD_US` the controller measures each wheel
+// from its encoder total, looks up the command that would produce the
+// measured speed, and adds a proportional and integral correction on the
+// difference to the feedforward command. Working on commands rather than
+// encoder rates keeps the gains the same across the motor's nonlinear range.
+//
+// All arithmetic is integer, for the AVR.
+class SpeedController
+{
+public:
+    SpeedController();
+
+    // Returns `false`, keeping the current calibration, if either table is
+    // not as `MotorCalibration` describes.
+    bool set_calibration(MotorCalibration const & calibration);
+    MotorCalibration const & calibration() const;
+
+    // Make the next `set_target()` start afresh, even with the same targets.
+    // Setting the calibration does too.
+    void restart();
+
+    // Track `left`, `right` from now (`now_us`, encoder totals
+    // `left_counts`, `right_counts`). Call `left_command()` and
+    // `right_command()` for the commands to write. Targets the same as the
+    // current ones change nothing, so the control loop carries on.
+    void set_target(
+        int16_t left,
+        int16_t right,
+        int32_t left_counts,
+        int32_t right_counts,
+        unsigned long now_us
+    );
+
+    // Update from new encoder totals. Returns `true` if the motor commands
+    // changed.
+    bool update(
+        int32_t left_counts,
+        int32_t right_counts,
+        unsigned long now_us
+    );
+
+    int16_t left_command() const;
+    int16_t right_command() const;
+
+    // Wheel speeds measured at the last update, in encoder counts per
+    // second.
+    int32_t left_rate() const;
+    int32_t right_rate() const;
+
+private:
+    struct WheelControl
+    {
+        int32_t target;
+        int32_t last_counts;
+        int32_t rate;
+        int32_t integral;
+        int16_t feedforward;
+        int16_t command;
+    };
+
+    // `true` if `rates` is a usable calibration table.
+    static bool valid(int16_t const * rates);
+
+    static int16_t command_for(int16_t const * rates, int32_t rate);
+
+    // Encoder counts per second for `speed`.
+    int32_t target_rate(int16_t speed) const;
+
+    void set_wheel(
+        WheelControl & wheel,
+        int16_t const * rates,
+        int16_t speed,
+        int32_t counts
+    );
+    bool update_wheel(
+        WheelControl & wheel,
+        int16_t const * rates,
+        int32_t counts,
+        uint32_t dt_us
+    );
+
+    MotorCalibration m_calibration;
+
+    // Encoder counts per second at speed 400.
+    int32_t m_top_rate;
+
+    WheelControl m_left;
+    WheelControl m_right;
+    unsigned long m_last_us;
+
+    // Whether `set_target()` must start afresh.
+    bool m_restart;
+};
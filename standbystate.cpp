@@ -7,7 +7,7 @@
 #include "standbystate.h"
 
 StandbyState::StandbyState(State * parent, IRobot & robot) :
-    RobotState("standby", parent, robot)
+    RobotStateT(STATEMACHINE_NAME("standby"), parent, robot)
 {}
 
 Result StandbyState::on_entry() 
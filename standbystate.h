@@ -8,12 +8,14 @@
 
 #include "robotstate.h"
 
-class StandbyState : public RobotState
+class StandbyState : public RobotStateT<StandbyState, TimerEvent>
 {
+    friend RobotStateT;
+
 public:
     StandbyState(State * parent, IRobot & robot);
 
 protected:
     Result on_entry() override;
-    bool on_event(TimerEvent & event) override;
+    bool on_event(TimerEvent & event);
 };
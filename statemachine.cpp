@@ -4,19 +4,37 @@
     This source code is released under the 3-Clause BSD license. See 
     LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
  */
+#include <string.h>
 #include "statemachine.h"
 
 namespace statemachine
 {
-    Event::Event(int const id, char const * name) :
+    void read_name(char const * name, char * buffer, uint8_t size)
+    {
+#ifdef STATEMACHINE_COMPACT
+        strncpy_P(buffer, name, size - 1);
+#else
+        strncpy(buffer, name, size - 1);
+#endif
+        buffer[size - 1] = '\0';
+    }
+
+    Event::Event(EventId const id, char const * name) :
         m_id(id),
         m_name(name)
     {}
 
-    State::State(char const * name, State * parent) :
+    State::State(char const * name, State * parent, uint16_t handled_events) :
         m_name(name),
-        m_active_state(nullptr),
-        m_parent_state(parent)
+        m_parent_state(parent),
+        m_handled_events(handled_events),
+        m_index(0),
+        m_depth(0),
+#ifdef STATEMACHINE_COMPACT
+        m_active_index(NO_STATE)
+#else
+        m_active_state(nullptr)
+#endif
     {}
 
     Result State::transition_to_state(State & state)
@@ -29,24 +47,52 @@ namespace statemachine
             // Destination state does not exist in state machine.
             return STATE_TRANSITION_FAILED;
         }
+#ifdef STATEMACHINE_COMPACT
+        if (!state.is_frozen())
+        {
+            // Active substates are kept by index, so only states in the
+            // table can be made active.
+            return STATE_TRANSITION_FAILED;
+        }
+#endif
 
         // Call on_exit() from active state to common parent.
+        Hook * const h = hook();
         for (; s != common_parent->m_parent_state; s = s->m_parent_state)
         {
-            s->on_exit();
+            if (h)
+            {
+                s->call_hooked(*h, ON_EXIT);
+            }
+            else
+            {
+                s->on_exit();
+            }
         }
 
         // Update active state pointers from common parent to `state`.
-        state.m_active_state = nullptr;
+        state.set_active_substate(nullptr);
         for (s = &state; s != common_parent; s = s->m_parent_state)
         {
-            s->m_parent_state->m_active_state = s;
+            s->m_parent_state->set_active_substate(s);
         }
+        root_state()->set_active_leaf(&state);
 
         // Call on_entry from common parent's active state to `state`.
-        for (s = common_parent->m_active_state; s; s = s->m_active_state)
+        for (
+            s = common_parent->active_substate();
+            s;
+            s = s->active_substate()
+        )
         {
-            s->on_entry();
+            if (h)
+            {
+                s->call_hooked(*h, ON_ENTRY);
+            }
+            else
+            {
+                s->on_entry();
+            }
         }
 
         return state.on_initialize();
@@ -56,9 +102,9 @@ namespace statemachine
     {
         // Follow new state's active state history down one sub-state.
         State * s = &state;
-        if (s->m_active_state) 
+        if (State * active = s->active_substate())
         {
-            s = s->m_active_state;
+            s = active;
         }
         return transition_to_state(*s);
     }
@@ -67,27 +113,32 @@ namespace statemachine
     {
         // Follow new state's active state history all the way down.
         State * s = &state;
-        while (s->m_active_state)
+        while (State * active = s->active_substate())
         {
-            s = s->m_active_state;
+            s = active;
         }
         return transition_to_state(*s);
     }
 
     Result State::handle_event(Event & event)
     {
-        bool handled = false;
+        uint16_t const bit = event_bit(event.m_id);
+        State * root = root_state();
+        Table const * t = root->table();
+        Hook * const h = t ? t->hook : nullptr;
 
-        for
-        (
-            State * s = active_state();
-            s and !(handled = s->on_event(event));
-            s = s->m_parent_state
-        )
-            // Event handled in for loop parameters.
-            ;
+        for (State * s = root->active_leaf(t); s; s = s->m_parent_state)
+        {
+            if (
+                (s->m_handled_events & bit) &&
+                (h ? s->call_hooked(*h, ON_EVENT, &event) : s->on_event(event))
+            )
+            {
+                return OK;
+            }
+        }
 
-        return handled ? OK : EVENT_NOT_HANDLED;
+        return EVENT_NOT_HANDLED;
     }
 
     char const * const State::active_state_name()
@@ -95,6 +146,87 @@ namespace statemachine
         return active_state()->m_name;
     }
 
+    Result State::freeze(
+        State * const * states,
+        uint8_t count,
+        uint8_t * lca_table
+    )
+    {
+        Table * t = table();
+        if (m_parent_state || !t)
+        {
+            // Not the root state, or nowhere to keep the table.
+            return STATE_TRANSITION_FAILED;
+        }
+
+        // Unfreeze, so a failure leaves the machine unfrozen rather than
+        // half frozen.
+        t->states = nullptr;
+        t->count = 0;
+        t->lca_table = nullptr;
+        if (count == NO_STATE)
+        {
+            // Too many states to index.
+            return STATE_TRANSITION_FAILED;
+        }
+
+        // Assign indices and depths.
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            State * state = states[i];
+            if (state->root_state() != this)
+            {
+                // State belongs to another machine.
+                return STATE_TRANSITION_FAILED;
+            }
+
+            state->m_index = i;
+            state->m_depth = 0;
+            for (State * s = state->m_parent_state; s; s = s->m_parent_state)
+            {
+                ++state->m_depth;
+            }
+        }
+
+        // Depths and common parents are found along parent chains, so every
+        // parent of a listed state must be listed too.
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            State * parent = states[i]->m_parent_state;
+            if (
+                parent &&
+                (parent->m_index >= count || states[parent->m_index] != parent)
+            )
+            {
+                return STATE_TRANSITION_FAILED;
+            }
+        }
+
+        t->states = states;
+        t->count = count;
+#ifdef STATEMACHINE_COMPACT
+        t->active_leaf = NO_STATE;
+#endif
+
+        // Precompute common parents.
+        if (lca_table)
+        {
+            for (uint8_t i = 0; i < count; ++i)
+            {
+                for (uint8_t j = 0; j < count; ++j)
+                {
+                    State * p = states[i]->find_common_parent_by_depth(
+                        states[j]
+                    );
+                    lca_table[i * count + j] = p ? p->m_index : NO_STATE;
+                }
+            }
+            t->lca_table = lca_table;
+        }
+
+        return OK;
+    }
+
     State * State::root_state()
     {
         State * s = this;
@@ -108,8 +240,51 @@ namespace statemachine
 
     State * State::active_state()
     {
-        State * s = root_state();
-        while (s->m_active_state) 
+        State * root = root_state();
+
+        return root->active_leaf(root->table());
+    }
+
+    State::Table * State::table()
+    {
+        return nullptr;
+    }
+
+#ifdef STATEMACHINE_COMPACT
+    State * State::active_leaf(Table const * t)
+    {
+        return t && t->active_leaf != NO_STATE ?
+            t->states[t->active_leaf] :
+            this;
+    }
+
+    State * State::active_substate()
+    {
+        return m_active_index == NO_STATE ?
+            nullptr :
+            root_state()->table()->states[m_active_index];
+    }
+
+    void State::set_active_substate(State * state)
+    {
+        m_active_index = state ? state->m_index : NO_STATE;
+    }
+
+    void State::set_active_leaf(State * state)
+    {
+        table()->active_leaf = state->m_index;
+    }
+#else
+    State * State::active_leaf(Table const * t)
+    {
+        if (t)
+        {
+            return t->active_leaf ? t->active_leaf : this;
+        }
+
+        // No cached leaf: follow the active substates down.
+        State * s = this;
+        while (s->m_active_state)
         {
             s = s->m_active_state;
         }
@@ -117,6 +292,53 @@ namespace statemachine
         return s;
     }
 
+    State * State::active_substate()
+    {
+        return m_active_state;
+    }
+
+    void State::set_active_substate(State * state)
+    {
+        m_active_state = state;
+    }
+
+    void State::set_active_leaf(State * state)
+    {
+        if (Table * t = table())
+        {
+            t->active_leaf = state;
+        }
+    }
+#endif
+
+    State::Hook * State::hook()
+    {
+        Table const * t = root_state()->table();
+
+        return t ? t->hook : nullptr;
+    }
+
+    bool State::call_hooked(Hook & hook, Handler handler, Event * event)
+    {
+        uint32_t const start = hook.before(*this, handler);
+        bool handled = true;
+        switch (handler)
+        {
+        case ON_EVENT:
+            handled = on_event(*event);
+            break;
+        case ON_ENTRY:
+            on_entry();
+            break;
+        case ON_EXIT:
+            on_exit();
+            break;
+        }
+        hook.after(*this, handler, start);
+
+        return handled;
+    }
+
     Result State::on_initialize() 
     {
         return OK;
@@ -145,6 +367,20 @@ namespace statemachine
             return nullptr;
         }
 
+        State * root = root_state();
+        if (other->root_state() == root && is_frozen() && other->is_frozen())
+        {
+            Table const * t = root->table();
+            if (t->lca_table)
+            {
+                uint8_t const idx =
+                    t->lca_table[m_index * t->count + other->m_index];
+                return idx == NO_STATE ? nullptr : t->states[idx];
+            }
+
+            return find_common_parent_by_depth(other);
+        }
+
         if (
             other == this &&
             this->m_parent_state == nullptr &&
@@ -178,4 +414,67 @@ namespace statemachine
         // No common parent.
         return nullptr;
     }
+
+    State * State::find_common_parent_by_depth(State * other)
+    {
+        // The common parent is the deepest state that is `this` or one of its
+        // parents, and is also one of `other`'s parents.
+        State * r = other->m_parent_state;
+        if (!r)
+        {
+            // `other` is the root state machine state, which only has itself
+            // as common parent.
+            return other == this ? this : nullptr;
+        }
+
+        State * l = this;
+        while (l->m_depth > r->m_depth)
+        {
+            l = l->m_parent_state;
+        }
+        while (r->m_depth > l->m_depth)
+        {
+            r = r->m_parent_state;
+        }
+        while (l != r)
+        {
+            l = l->m_parent_state;
+            r = r->m_parent_state;
+        }
+
+        return l;
+    }
+
+    uint8_t State::index()
+    {
+        return is_frozen() ? m_index : NO_STATE;
+    }
+
+    char const * State::name()
+    {
+        return m_name;
+    }
+
+    State * State::state_at(uint8_t index)
+    {
+        Table const * t = root_state()->table();
+
+        if (!t || !t->states || index >= t->count)
+        {
+            return nullptr;
+        }
+
+        return t->states[index];
+    }
+
+    bool State::is_frozen()
+    {
+        Table const * t = root_state()->table();
+
+        return
+            t &&
+            t->states &&
+            m_index < t->count &&
+            t->states[m_index] == this;
+    }
 }
\ No newline at end of file
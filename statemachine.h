@@ -6,6 +6,22 @@
  */
 #pragma once
 
+#include <stdint.h>
+
+// Compact build: define STATEMACHINE_COMPACT, e.g. with
+// `-DSTATEMACHINE_COMPACT` in the build flags, to shrink states and events
+// for small RAM. State and event names live in program memory (see
+// STATEMACHINE_NAME()), event identifiers are 8 bits, and states refer to
+// their active substates by 8-bit index into the frozen state table, which
+// the root state holds (see `State::table()`). States must be frozen before
+// the first transition. See host/footprint.cpp for the bytes saved.
+#ifdef STATEMACHINE_COMPACT
+#include <avr/pgmspace.h>
+#define STATEMACHINE_NAME(name) PSTR(name)
+#else
+#define STATEMACHINE_NAME(name) (name)
+#endif
+
 namespace statemachine
 {
     /**
@@ -18,8 +34,54 @@ namespace statemachine
         EVENT_NOT_HANDLED
     };
 
+    /**
+     * Handled events mask with every bit set. See `State::State()`.
+     */
+    uint16_t const ALL_EVENTS = 0xFFFF;
+
+    /**
+     * Get the bit for an event in a handled events mask.
+     *
+     * @param id
+     * Event identifier. Identifiers outside 0 through 15 map to every bit.
+     *
+     * @return mask bit(s) for `id`.
+     */
+    inline uint16_t event_bit(int id)
+    {
+        return id >= 0 && id < 16 ? static_cast<uint16_t>(1u << id) : ALL_EVENTS;
+    }
+
+    /**
+     * Event identifier type. 8 bits in the compact build.
+     */
+#ifdef STATEMACHINE_COMPACT
+    typedef uint8_t EventId;
+#else
+    typedef int EventId;
+#endif
+
+    /**
+     * Copy a state or event name to RAM, from program memory in the compact
+     * build.
+     *
+     * @param name
+     * Name, as passed to the `State` or `Event` constructor.
+     *
+     * @param buffer
+     * Storage for the copy. Always NUL terminated.
+     *
+     * @param size
+     * Bytes in `buffer`. Longer names are cut short.
+     */
+    void read_name(char const * name, char * buffer, uint8_t size);
+
     /**
      * Base class for events that are to be processed by state machine states.
+     *
+     * Events are not polymorphic. There is no virtual destructor, so events
+     * carry no vtable pointer and can be copied into fixed-size queue slots
+     * by value. Do not delete derived events through an `Event` pointer.
      */
     class Event
     {
@@ -33,18 +95,19 @@ namespace statemachine
          *
          * @param name
          * Human-readable identifier. Useful for debugging. `name` does not get
-         * deallocated by the class destructor.
+         * deallocated by the class destructor. Pass string literals through
+         * STATEMACHINE_NAME().
          */
-        Event(int id, char const * name);
-        virtual ~Event() = default;
+        Event(EventId id, char const * name);
 
         /**
          * Unique event identifier.
          */
-        int const m_id;
+        EventId const m_id;
 
         /**
-         * Human-readable name. Useful for debugging.
+         * Human-readable name. Useful for debugging. In program memory in the
+         * compact build; see `read_name()`.
          */
         char const * m_name;
     };
@@ -55,19 +118,104 @@ namespace statemachine
     class State
     {
     public:
+        /**
+         * State handlers, as passed to a `Hook`.
+         */
+        enum Handler : uint8_t
+        {
+            ON_EVENT,
+            ON_ENTRY,
+            ON_EXIT
+        };
+
+        /**
+         * Observer of every call the machine makes to a state's `on_event()`,
+         * `on_entry()` and `on_exit()`, e.g. to time them. Set it in the root
+         * state's `table()`.
+         */
+        class Hook
+        {
+        public:
+            /**
+             * Called before a state's handler.
+             *
+             * @return value passed to `after()`, e.g. the start time.
+             */
+            virtual uint32_t before(State & state, Handler handler) = 0;
+
+            /**
+             * Called after the handler returns, including any transition it
+             * made.
+             *
+             * @param start
+             * Value `before()` returned.
+             */
+            virtual void after(State & state, Handler handler, uint32_t start)
+                = 0;
+
+        protected:
+            ~Hook() = default;
+        };
+
+        /**
+         * Frozen state table and active leaf state, kept once per machine
+         * rather than in every state. See `table()`.
+         */
+        struct Table
+        {
+            /**
+             * Every state in the machine, common parent of every pair by
+             * index (or `nullptr`), and number of states.
+             */
+            State * const * states;
+            uint8_t * lca_table;
+            uint8_t count;
+
+            /**
+             * Innermost active state, by index in the compact build. `nullptr`
+             * (NO_STATE) until the first transition, meaning the root state
+             * is active.
+             */
+#ifdef STATEMACHINE_COMPACT
+            uint8_t active_leaf;
+#else
+            State * active_leaf;
+#endif
+
+            /**
+             * Handler hook, or `nullptr`.
+             */
+            Hook * hook;
+        };
+
+        /**
+         * Index of no state.
+         */
+        static uint8_t const NO_STATE = 0xFF;
+
         /**
          * State machine state constructor.
          *
          * @param name
          * `name` is a human-readable state identifier. Useful for debugging.
-         * `name` does not get deallocated by the class destructor.
+         * `name` does not get deallocated by the class destructor. Pass string
+         * literals through STATEMACHINE_NAME().
          *
          * @param parent
          * Pass nullptr as the `parent` state for the root state machine state.
          * Otherwise, pass the parent (containing) state as the `parent`
          * argument.
+         *
+         * @param handled_events
+         * Mask of `event_bit()`s for the events `on_event` can handle.
+         * `handle_event` skips this state, without calling `on_event`, for
+         * events not in the mask.
          */
-        State(char const * name, State * parent);
+        State(
+            char const * name,
+            State * parent,
+            uint16_t handled_events = ALL_EVENTS
+        );
         virtual ~State() = default;
 
         /**
@@ -110,7 +258,9 @@ namespace statemachine
         /**
          * Process event.
          * Call this from the state machine root class instance to process
-         * an event.
+         * an event. The event is offered to the active state, then its
+         * parents, skipping states whose handled events mask excludes it,
+         * until one handles it.
          *
          * @param event
          * Event to process.
@@ -128,6 +278,68 @@ namespace statemachine
          * @return active state name.
          */
         char const * const active_state_name();
+
+        /**
+         * Freeze the state tree. Optional, except in the compact build.
+         * Call on the root state once all states are constructed. Assigns each
+         * state its index in `states` and its depth, so common parents are
+         * found by walking both chains up from equal depth (O(depth)) rather
+         * than comparing every pair of ancestors (O(depth^2)). With
+         * `lca_table`, common parents of every pair of states are precomputed
+         * and looked up in constant time.
+         *
+         * Leaf states missing from `states` still work, using the unfrozen
+         * lookup, except in the compact build, where transitions to them fail.
+         * The parent of every listed state must be listed too.
+         *
+         * @param states
+         * Every state in the machine, root included. At most 254 states. Must
+         * outlive the machine.
+         *
+         * @param count
+         * Number of entries in `states`.
+         *
+         * @param lca_table
+         * `count * count` bytes of storage for precomputed common parents, or
+         * `nullptr` to skip precomputation. Must outlive the machine.
+         *
+         * @return result code. OK => success. STATE_TRANSITION_FAILED => not
+         * called on the root state, the root state has no `table()`, too many
+         * states, a state belongs to another machine, or a listed state's
+         * parent is not listed. Failures on a root state with a table leave
+         * the machine unfrozen.
+         */
+        Result freeze(
+            State * const * states,
+            uint8_t count,
+            uint8_t * lca_table = nullptr
+        );
+
+        /**
+         * Get this state's index in the frozen state table.
+         *
+         * @return index in the `states` passed to `freeze()`, or 0xFF if the
+         * state is not in the table.
+         */
+        uint8_t index();
+
+        /**
+         * Get this state's name.
+         *
+         * @return name, as passed to the constructor. See `read_name()`.
+         */
+        char const * name();
+
+        /**
+         * Get a state of a frozen machine by its index.
+         *
+         * @param index
+         * Index in the `states` passed to `freeze()`.
+         *
+         * @return state, or `nullptr` if the machine is not frozen or `index`
+         * is out of range.
+         */
+        State * state_at(uint8_t index);
         
     protected:
         /**
@@ -174,6 +386,7 @@ namespace statemachine
 
         /**
          * Get the root (machine) state.
+         * Walks the parent chain.
          *
          * @return pointer to root state.
          */
@@ -181,11 +394,25 @@ namespace statemachine
 
         /**
          * Get the current active state.
+         * Constant time if the root state has a `table()`, which caches the
+         * active leaf state. Otherwise follows the active substates down from
+         * the root state.
          *
          * @return pointer to the active state.
          */
         State * active_state();
 
+        /**
+         * Get the frozen state table. Called on the root state.
+         *
+         * The table is not kept in every state: override this in the root
+         * state to return storage for it, zero initialized, which `freeze()`
+         * and `transition_to_state` fill in. Required in the compact build.
+         *
+         * @return table, or `nullptr` if there is no storage for it.
+         */
+        virtual Table * table();
+
         /**
          * Find the common parent of `this` state with state `other`.
          *
@@ -198,21 +425,98 @@ namespace statemachine
         State * find_common_parent(State * other);
 
         /**
-         * Human-readable name. Useful for debugging.
+         * Find the common parent of `this` state with state `other` by
+         * equalizing depths, then walking both parent chains in lockstep.
+         * Requires the state tree to be frozen.
+         *
+         * @param other
+         * Pointer to other state.
+         *
+         * @return pointer to common parent, or `nullptr` if there is not common
+         * parent.
          */
-        char const * const m_name;
+        State * find_common_parent_by_depth(State * other);
 
         /**
-         * Points to the immediate substate contained within this state that is
-         * active. Creates a pointer chain from the root state machine state to
-         * the currently active state.
+         * Determine whether this state is in the frozen state table.
+         *
+         * @return `true` if frozen, else `false`.
          */
-        State * m_active_state;
+        bool is_frozen();
+
+        /**
+         * Human-readable name. Useful for debugging. In program memory in the
+         * compact build; see `read_name()`.
+         */
+        char const * const m_name;
 
         /**
          * Points to the state containing this state. * Creates a pointer chain
          * to the root state machine state.
          */
         State * m_parent_state;
+
+        /**
+         * Mask of `event_bit()`s for events this state handles.
+         */
+        uint16_t const m_handled_events;
+
+        /**
+         * Index into the frozen state table, and distance from the root
+         * state. Assigned by `freeze()`.
+         */
+        uint8_t m_index;
+        uint8_t m_depth;
+
+    private:
+        /**
+         * Get or set the immediate substate contained within this state that
+         * is active, `nullptr` if none has been. Creates a chain from the root
+         * state machine state to the currently active state.
+         */
+        State * active_substate();
+        void set_active_substate(State * state);
+
+        /**
+         * Get the innermost active state. Called on the root state, with its
+         * `table()`.
+         */
+        State * active_leaf(Table const * t);
+
+        /**
+         * Set the innermost active state. Called on the root state. Does
+         * nothing if it has no `table()`.
+         */
+        void set_active_leaf(State * state);
+
+        /**
+         * Get the root state's handler hook, or `nullptr`.
+         */
+        Hook * hook();
+
+        /**
+         * Call this state's `handler`, with `event` for `ON_EVENT`, between
+         * the `hook`'s `before()` and `after()`.
+         *
+         * @return what `on_event()` returned, else `true`.
+         */
+        bool call_hooked(
+            Hook & hook,
+            Handler handler,
+            Event * event = nullptr
+        );
+
+#ifdef STATEMACHINE_COMPACT
+        /**
+         * Index of the active substate in the frozen state table, or
+         * NO_STATE.
+         */
+        uint8_t m_active_index;
+#else
+        /**
+         * Active substate.
+         */
+        State * m_active_state;
+#endif
     };
 }
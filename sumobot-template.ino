@@ -11,25 +11,24 @@
 #include <Zumo32U4.h>
 #include "eventqueue.h"
 #include "events.h"
-#include "initstate.h"
+#include "profiler.h"
 #include "robot.h"
 #include "robotstatemachine.h"
-#include "standbystate.h"
+#include "trace.h"
 
 // Robot interface.
 IRobot robot;
 
-// State machine.
-RobotStateMachine machine(nullptr, robot);
-InitState initialized(&machine, robot);
-StandbyState standby(&machine, robot);
-
-EventQueue queue;
+// State machine. Owns its states.
+RobotStateMachine machine(robot);
 
 void setup()
 {
-    // Initialize robot.
+    // Initialize robot. Report repeating boundary and proximity detections
+    // once, when they change, rather than on every pass.
     robot.setup();
+    robot.set_event_policy(BOUNDARY_EVENT, EDGE);
+    robot.set_event_policy(PROXIMITY_EVENT, EDGE);
 
     // Initialize state machine.
     machine.transition_to_state(machine);
@@ -37,13 +36,28 @@ void setup()
 
 void loop()
 {
+    PROFILE_SCOPE(PROFILE_LOOP);
+
     // Read sensors, and generate events.
-    robot.generate_events(queue);
+    robot.generate_events();
 
-    // Process events.
-    while (!queue.empty())
+    // Process events. Events are dispatched in place, then released. Each
+    // pass takes the oldest event of the highest priority lane, so a boundary
+    // event is handled before anything else queued.
     {
-        Event * e = queue.pop();
-        machine.handle_event(*e);
+        PROFILE_SCOPE(PROFILE_DRAIN);
+        EventQueue & events = robot.events();
+        while (RobotEventSlot * slot = events.front())
+        {
+            TRACE_EVENT(*slot);
+            machine.handle_event(slot->event());
+            events.pop();
+        }
     }
+
+    // Write the motor command left by the handlers, once.
+    robot.commit_motors();
+
+    // Update the display without stalling the loop.
+    robot.update_display();
 }
@@ -0,0 +1,146 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See 
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Hashed timer wheel with millisecond resolution.
+//
+// Holds `TIMERS` timers, identified by index, any number of which may be
+// running at once. A running timer is kept on a doubly linked list in the
+// slot its deadline hashes to, so starting and cancelling a timer take
+// constant time. `expire()` visits one slot per elapsed millisecond (at most
+// every slot once per call), so its cost depends on elapsed time and the
+// timers sharing those slots, not on how many timers are running.
+//
+// Deadlines are compared across millis() wraparound, so timeouts must be
+// shorter than about 24 days.
+template <uint8_t TIMERS, uint8_t SLOTS>
+class TimerWheel
+{
+    static_assert(
+        SLOTS && !(SLOTS & (SLOTS - 1)),
+        "Timer wheel slot count must be a power of two."
+    );
+    static_assert(TIMERS < 0xFF, "Timer wheel holds at most 254 timers.");
+
+public:
+    TimerWheel() : m_last_ms(0)
+    {
+        for (uint8_t & slot : m_slots)
+        {
+            slot = NIL;
+        }
+        for (Timer & timer : m_timers)
+        {
+            timer.deadline_ms = 0;
+            timer.next = timer.prev = NIL;
+            timer.running = false;
+        }
+    }
+
+    // Call once at start up, before the first `expire()`.
+    void reset(unsigned long now_ms)
+    {
+        m_last_ms = now_ms;
+    }
+
+    // Start, or restart, timer `id` to expire `timeout_ms` from `now_ms`.
+    void start(uint8_t id, unsigned long now_ms, unsigned long timeout_ms)
+    {
+        cancel(id);
+
+        Timer & timer = m_timers[id];
+        // A deadline of `now_ms` could hash to a slot already visited.
+        timer.deadline_ms = now_ms + (timeout_ms ? timeout_ms : 1);
+        timer.running = true;
+
+        uint8_t & slot = m_slots[timer.deadline_ms & MASK];
+        timer.prev = NIL;
+        timer.next = slot;
+        if (slot != NIL)
+        {
+            m_timers[slot].prev = id;
+        }
+        slot = id;
+    }
+
+    // Stop timer `id`, if it is running.
+    void cancel(uint8_t id)
+    {
+        Timer & timer = m_timers[id];
+        if (!timer.running)
+        {
+            return;
+        }
+
+        if (timer.prev != NIL)
+        {
+            m_timers[timer.prev].next = timer.next;
+        }
+        else
+        {
+            m_slots[timer.deadline_ms & MASK] = timer.next;
+        }
+        if (timer.next != NIL)
+        {
+            m_timers[timer.next].prev = timer.prev;
+        }
+        timer.running = false;
+    }
+
+    bool running(uint8_t id) const
+    {
+        return m_timers[id].running;
+    }
+
+    // Stop every timer whose deadline is at or before `now_ms`, and call
+    // `on_expire(id)` for each. `on_expire` must not start or cancel timers.
+    template <typename F>
+    void expire(unsigned long now_ms, F on_expire)
+    {
+        unsigned long const elapsed_ms = now_ms - m_last_ms;
+        uint8_t const ticks = elapsed_ms >= SLOTS ? SLOTS : elapsed_ms;
+
+        for (uint8_t i = 1; i <= ticks; ++i)
+        {
+            uint8_t id = m_slots[(m_last_ms + i) & MASK];
+            while (id != NIL)
+            {
+                uint8_t const next = m_timers[id].next;
+                if (static_cast<long>(now_ms - m_timers[id].deadline_ms) >= 0)
+                {
+                    cancel(id);
+                    on_expire(id);
+                }
+                id = next;
+            }
+        }
+
+        m_last_ms = now_ms;
+    }
+
+private:
+    static uint8_t const NIL = 0xFF;
+    static uint8_t const MASK = SLOTS - 1;
+
+    struct Timer
+    {
+        unsigned long deadline_ms;
+        uint8_t next;
+        uint8_t prev;
+        bool running;
+    };
+
+    Timer m_timers[TIMERS];
+
+    // First timer in each slot, or NIL.
+    uint8_t m_slots[SLOTS];
+
+    // Time of the last `expire()`. Slots up to here have been visited.
+    unsigned long m_last_ms;
+};
@@ -0,0 +1,108 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#include "trace.h"
+
+bool trace_header_valid(TraceHeader const & header)
+{
+    return
+        memcmp(header.magic, "SBTR", sizeof(header.magic)) == 0 &&
+        header.version == TRACE_VERSION &&
+        header.record_size == sizeof(TraceRecord);
+}
+
+bool trace_decode_event(TraceRecord const & record, RobotEventSlot & slot)
+{
+    switch (record.type)
+    {
+    case BOUNDARY_EVENT:
+        slot = BoundaryEvent(static_cast<DetectDirection>(record.data[0]));
+        return true;
+    case CONTACT_EVENT:
+        slot = ContactEvent(
+            static_cast<ContactType>(record.data[0]),
+            static_cast<ContactSide>(record.data[1]),
+            record.data[2]
+        );
+        return true;
+    case ENCODER_EVENT:
+        slot = EncoderEvent(record.data[0]);
+        return true;
+    case PROXIMITY_EVENT:
+        slot = ProximityEvent(
+            static_cast<DetectDirection>(record.data[0] & 0x03),
+            (record.data[0] >> 2) & 0x07,
+            record.data[0] >> 5,
+            static_cast<int8_t>(record.data[1]),
+            record.data[2]
+        );
+        return true;
+    case START_EVENT:
+        slot = StartButtonEvent();
+        return true;
+    case TIMER_EVENT:
+        slot = TimerEvent(record.data[0]);
+        return true;
+    default:
+        return false;
+    }
+}
+
+#ifdef TRACING
+
+Trace trace;
+
+Trace::Trace()
+{
+    reset();
+}
+
+void Trace::reset()
+{
+    m_written = 0;
+}
+
+void Trace::event(RobotEventSlot & slot)
+{
+    TraceRecord & r = next(slot.kind());
+    Event & e = slot.event();
+
+    r.data[0] = r.data[1] = r.data[2] = 0;
+    switch (slot.kind())
+    {
+    case BOUNDARY_EVENT:
+        r.data[0] = static_cast<BoundaryEvent &>(e).m_direction;
+        break;
+    case CONTACT_EVENT:
+    {
+        ContactEvent & c = static_cast<ContactEvent &>(e);
+        r.data[0] = c.m_type;
+        r.data[1] = c.m_side;
+        r.data[2] = c.m_strength;
+        break;
+    }
+    case ENCODER_EVENT:
+        r.data[0] = static_cast<EncoderEvent &>(e).m_target;
+        break;
+    case PROXIMITY_EVENT:
+    {
+        ProximityEvent & p = static_cast<ProximityEvent &>(e);
+        r.data[0] = p.m_direction |
+            (p.m_left_brightness & 0x07) << 2 |
+            (p.m_right_brightness & 0x07) << 5;
+        r.data[1] = static_cast<uint8_t>(p.m_bearing);
+        r.data[2] = p.m_confidence;
+        break;
+    }
+    case TIMER_EVENT:
+        r.data[0] = static_cast<TimerEvent &>(e).m_timer;
+        break;
+    default:
+        break;
+    }
+}
+
+#endif
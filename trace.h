@@ -0,0 +1,170 @@
+/*
+    Copyright 2019, Andrew Lin.
+
+    This source code is released under the 3-Clause BSD license. See
+    LICENSE.txt, or https://opensource.org/licenses/BSD-3-Clause.
+ */
+#pragma once
+
+// Event and transition trace.
+//
+// Records every event dispatched to the state machine, with its payload, and
+// every state transition, as fixed-size binary records in a RAM ring buffer.
+// The oldest records are overwritten once the buffer is full.
+// `trace.dump(Serial)` writes the buffer out, and `host/replay` decodes it and
+// replays the events into a host build of the state machine.
+//
+// Recording compiles out completely unless TRACING is defined, e.g. with
+// `-DTRACING` in the build flags.
+
+#include <stdint.h>
+#include "events.h"
+
+// Record types. Values below TRACE_TRANSITION_RECORD are `RobotEvent` values.
+enum TraceType : uint8_t
+{
+    TRACE_TRANSITION_RECORD = 0x80
+};
+
+// One trace record. Multi-byte fields are in the byte order of the recording
+// machine, little-endian on both the robot and x86 hosts.
+struct TraceRecord
+{
+    // micros() when recorded.
+    uint32_t time_us;
+
+    // `RobotEvent`, or TRACE_TRANSITION_RECORD.
+    uint8_t type;
+
+    // Event payload, in the order of the event class's members, or the source
+    // and target state indices of a transition. A `ProximityEvent` packs its
+    // direction and brightnesses (each at most 6) into the first byte, as
+    // bits 0-1, 2-4 and 5-7.
+    uint8_t data[3];
+};
+
+static_assert(sizeof(TraceRecord) == 8, "Trace records must be 8 bytes.");
+
+// Header written by `Trace::dump()` before the records.
+struct TraceHeader
+{
+    char magic[4];
+    uint8_t version;
+    uint8_t record_size;
+    // Number of records that follow, oldest first.
+    uint16_t count;
+    // Records overwritten before the dump.
+    uint32_t dropped;
+};
+
+static_assert(sizeof(TraceHeader) == 12, "Trace header must be 12 bytes.");
+
+uint8_t const TRACE_VERSION = 3;
+
+// Check the magic number and version of `header`.
+bool trace_header_valid(TraceHeader const & header);
+
+// Rebuild the event in `record` into `slot`.
+//
+// @return `false` if `record` does not hold an event.
+bool trace_decode_event(TraceRecord const & record, RobotEventSlot & slot);
+
+#ifdef TRACING
+
+#include <Arduino.h>
+
+// Records held. Must be a power of two.
+#ifndef TRACE_RECORDS
+#define TRACE_RECORDS 32
+#endif
+
+class Trace
+{
+    static_assert(
+        TRACE_RECORDS && !(TRACE_RECORDS & (TRACE_RECORDS - 1)),
+        "Trace record count must be a power of two."
+    );
+
+public:
+    Trace();
+
+    // Discard all records.
+    void reset();
+
+    // Record an event about to be dispatched.
+    void event(RobotEventSlot & slot);
+
+    // Record a transition between states, by frozen state index.
+    void transition(uint8_t source, uint8_t target)
+    {
+        TraceRecord & r = next(TRACE_TRANSITION_RECORD);
+        r.data[0] = source;
+        r.data[1] = target;
+        r.data[2] = 0;
+    }
+
+    // Records held, at most TRACE_RECORDS.
+    uint16_t size() const
+    {
+        return m_written < TRACE_RECORDS ? m_written : TRACE_RECORDS;
+    }
+
+    // Records overwritten.
+    uint32_t dropped() const
+    {
+        return m_written - size();
+    }
+
+    // Record `i`, oldest first.
+    TraceRecord const & record(uint16_t i) const
+    {
+        return m_records[(m_written - size() + i) & (TRACE_RECORDS - 1)];
+    }
+
+    // Write a TraceHeader, then every record, oldest first, to `out`, which
+    // needs `write(uint8_t const *, size_t)`, as Arduino's `Serial` has.
+    template <typename Out>
+    void dump(Out & out) const
+    {
+        TraceHeader header =
+        {
+            {'S', 'B', 'T', 'R'},
+            TRACE_VERSION,
+            sizeof(TraceRecord),
+            size(),
+            dropped()
+        };
+        out.write(reinterpret_cast<uint8_t const *>(&header), sizeof(header));
+        for (uint16_t i = 0; i < size(); ++i)
+        {
+            out.write(
+                reinterpret_cast<uint8_t const *>(&record(i)),
+                sizeof(TraceRecord)
+            );
+        }
+    }
+
+private:
+    TraceRecord & next(uint8_t type)
+    {
+        TraceRecord & r = m_records[m_written++ & (TRACE_RECORDS - 1)];
+        r.time_us = micros();
+        r.type = type;
+        return r;
+    }
+
+    TraceRecord m_records[TRACE_RECORDS];
+    uint32_t m_written;
+};
+
+extern Trace trace;
+
+#define TRACE_EVENT(slot) trace.event(slot)
+#define TRACE_TRANSITION(source, target) trace.transition(source, target)
+
+#else
+
+#define TRACE_EVENT(slot)
+#define TRACE_TRANSITION(source, target)
+
+#endif